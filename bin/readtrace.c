@@ -0,0 +1,339 @@
+/// Program that decodes, filters and summarizes Nachos execution traces
+/// (see `trace.h`).
+///
+/// Usage: readtrace [-p] [-s] [-t <kinds>] [-a <low> <high>] <trace file>
+///
+/// * `-p` -- prints every record, one per line.  Sequential instructions
+///   of delta-encoded traces are printed one by one, so both encodings of
+///   the same run print the same.
+/// * `-s` -- prints a summary of the trace (the default, unless `-p` is
+///   given).
+/// * `-t` -- prints only the records of the given kinds: `i` for
+///   instructions, `m` for memory accesses, `e` for exceptions and `s` for
+///   thread switches (for example, `-t me`).
+/// * `-a` -- prints only the instructions and memory accesses with an
+///   address between `low` (included) and `high` (excluded).
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "trace.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static const char *EXCEPTION_NAMES[] = {
+    "NO_EXCEPTION", "SYSCALL_EXCEPTION", "PAGE_FAULT_EXCEPTION",
+    "READ_ONLY_EXCEPTION", "BUS_ERROR_EXCEPTION", "ADDRESS_ERROR_EXCEPTION",
+    "OVERFLOW_EXCEPTION", "ILLEGAL_INSTR_EXCEPTION"
+};
+#define NUM_EXCEPTION_NAMES \
+  (sizeof EXCEPTION_NAMES / sizeof EXCEPTION_NAMES[0])
+
+/// What to print.
+typedef struct options {
+    bool print;
+    bool summary;
+    bool kinds[NUM_TRACE_TAGS];
+    uint32_t low, high;
+} options;
+
+/// What was found in the trace.
+typedef struct summary {
+    unsigned long instructions;
+    unsigned long accesses[2];       // Loads, stores.
+    unsigned long bytes[2];
+    unsigned long exceptions[256];
+    unsigned long switches;
+    unsigned long *processTicks;     // Instructions run by each process,
+    unsigned numProcesses;           // indexed by identifier plus one.
+    unsigned current;                // Process holding the CPU.
+} summary;
+
+static bool truncated;
+
+static unsigned
+ReadByte(FILE *f)
+{
+    int c = getc(f);
+    if (c == EOF) {
+        truncated = true;
+        return 0;
+    }
+    return c;
+}
+
+static uint32_t
+ReadField(FILE *f, bool delta)
+{
+    uint32_t value = 0;
+    if (delta) {
+        unsigned shift = 0, b;
+        do {
+            b = ReadByte(f);
+            if (shift < 32) {
+                value |= (uint32_t) (b & 0x7F) << shift;
+            }
+            shift += 7;
+        } while (b & 0x80 && !truncated);
+    } else {
+        for (unsigned i = 0; i < 4; i++) {
+            value |= (uint32_t) ReadByte(f) << (8 * i);
+        }
+    }
+    return value;
+}
+
+/// Read an address, relative to `*last` in delta traces.
+static uint32_t
+ReadAddress(FILE *f, bool delta, uint32_t *last)
+{
+    uint32_t value = ReadField(f, delta);
+    if (delta) {
+        // Unfold the sign from the low bit.
+        value = *last + ((value >> 1) ^ -(value & 1));
+    }
+    *last = value;
+    return value;
+}
+
+static bool
+InRange(const options *o, uint32_t addr)
+{
+    return o->low <= addr && addr < o->high;
+}
+
+static void
+CountInstructions(summary *s, unsigned long n)
+{
+    s->instructions += n;
+    if (s->current >= s->numProcesses) {
+        unsigned count = s->current + 1;
+        s->processTicks = realloc(s->processTicks,
+                                  count * sizeof *s->processTicks);
+        memset(&s->processTicks[s->numProcesses], 0,
+               (count - s->numProcesses) * sizeof *s->processTicks);
+        s->numProcesses = count;
+    }
+    s->processTicks[s->current] += n;
+}
+
+static void
+PrintSummary(const summary *s, const char *path, const traceHeader *h)
+{
+    printf("%s: Nachos trace, version %u%s\n"
+           "    Instructions: %lu\n"
+           "    Loads: %lu (%lu bytes)\n"
+           "    Stores: %lu (%lu bytes)\n",
+           path, h->version, h->flags & TRACE_DELTA ? ", delta-encoded" : "",
+           s->instructions, s->accesses[0], s->bytes[0],
+           s->accesses[1], s->bytes[1]);
+
+    unsigned long exceptions = 0;
+    for (unsigned i = 0; i < 256; i++) {
+        exceptions += s->exceptions[i];
+    }
+    printf("    Exceptions: %lu\n", exceptions);
+    for (unsigned i = 0; i < 256; i++) {
+        if (s->exceptions[i] == 0) {
+            continue;
+        }
+        if (i < NUM_EXCEPTION_NAMES) {
+            printf("        %s: %lu\n", EXCEPTION_NAMES[i], s->exceptions[i]);
+        } else {
+            printf("        Exception %u: %lu\n", i, s->exceptions[i]);
+        }
+    }
+
+    printf("    Thread switches: %lu\n", s->switches);
+    for (unsigned i = 0; i < s->numProcesses; i++) {
+        if (s->processTicks[i] == 0) {
+            continue;
+        }
+        if (i == 0) {
+            printf("        Instructions by threads without a process: %lu\n",
+                   s->processTicks[i]);
+        } else {
+            printf("        Instructions by process %u: %lu\n",
+                   i - 1, s->processTicks[i]);
+        }
+    }
+    if (truncated) {
+        printf("    The trace is truncated.\n");
+    }
+}
+
+static void
+Usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-p] [-s] [-t <kinds>] [-a <low> <high>] "
+                    "<trace file>\n", name);
+}
+
+int
+main(int argc, char *argv[])
+{
+    options o;
+    memset(&o, 0, sizeof o);
+    o.high = UINT32_MAX;
+    bool filtered = false;
+
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (!strcmp(argv[i], "-p")) {
+            o.print = true;
+        } else if (!strcmp(argv[i], "-s")) {
+            o.summary = true;
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            filtered = true;
+            for (const char *k = argv[++i]; *k != '\0'; k++) {
+                switch (*k) {
+                    case 'i':
+                        o.kinds[TRACE_PC] = o.kinds[TRACE_STEPS] = true;
+                        break;
+                    case 'm':
+                        o.kinds[TRACE_LOAD] = o.kinds[TRACE_STORE] = true;
+                        break;
+                    case 'e':
+                        o.kinds[TRACE_EXCEPTION] = true;
+                        break;
+                    case 's':
+                        o.kinds[TRACE_SWITCH] = true;
+                        break;
+                    default:
+                        Usage(argv[0]);
+                        return 1;
+                }
+            }
+        } else if (!strcmp(argv[i], "-a") && i + 2 < argc) {
+            o.low  = strtoul(argv[++i], NULL, 0);
+            o.high = strtoul(argv[++i], NULL, 0);
+        } else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (i + 1 != argc) {
+        Usage(argv[0]);
+        return 1;
+    }
+    if (!filtered) {
+        for (unsigned k = 0; k < NUM_TRACE_TAGS; k++) {
+            o.kinds[k] = true;
+        }
+    }
+    if (!o.print) {
+        o.summary = true;
+    }
+
+    // Open the trace and read its header, which is in little endian.
+    const char *path = argv[i];
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+    traceHeader h;
+    h.magic   = ReadField(f, false);
+    h.version = ReadByte(f);
+    h.version |= ReadByte(f) << 8;
+    h.flags   = ReadByte(f);
+    h.flags   |= ReadByte(f) << 8;
+    if (truncated || h.magic != TRACE_MAGIC || h.version != TRACE_VERSION) {
+        fprintf(stderr, "%s: not a Nachos trace of version %u\n",
+                path, TRACE_VERSION);
+        fclose(f);
+        return 1;
+    }
+    bool delta = h.flags & TRACE_DELTA;
+
+    summary s;
+    memset(&s, 0, sizeof s);
+    uint32_t nextPc = 0, lastData = 0;
+    int tag;
+    while ((tag = getc(f)) != EOF) {
+        switch (tag) {
+            case TRACE_PC: {
+                uint32_t pc = ReadAddress(f, delta, &nextPc);
+                nextPc = pc + 4;
+                CountInstructions(&s, 1);
+                if (o.print && o.kinds[tag] && InRange(&o, pc)) {
+                    printf("pc 0x%08X\n", pc);
+                }
+                break;
+            }
+            case TRACE_STEPS: {
+                uint32_t n = ReadField(f, delta);
+                CountInstructions(&s, n);
+                for (uint32_t j = 0; j < n && o.print && o.kinds[tag]; j++) {
+                    if (InRange(&o, nextPc + 4 * j)) {
+                        printf("pc 0x%08X\n", nextPc + 4 * j);
+                    }
+                }
+                nextPc += 4 * n;
+                break;
+            }
+            case TRACE_LOAD:
+            case TRACE_STORE: {
+                bool store = tag == TRACE_STORE;
+                unsigned size = ReadByte(f);
+                uint32_t addr = ReadAddress(f, delta, &lastData);
+                s.accesses[store]++;
+                s.bytes[store] += size;
+                if (o.print && o.kinds[tag] && InRange(&o, addr)) {
+                    printf("%s %u 0x%08X\n", store ? "store" : "load",
+                           size, addr);
+                }
+                break;
+            }
+            case TRACE_EXCEPTION: {
+                unsigned type = ReadByte(f);
+                uint32_t badVAddr = ReadField(f, delta);
+                s.exceptions[type]++;
+                if (o.print && o.kinds[tag]) {
+                    if (type < NUM_EXCEPTION_NAMES) {
+                        printf("exception %s 0x%08X\n",
+                               EXCEPTION_NAMES[type], badVAddr);
+                    } else {
+                        printf("exception %u 0x%08X\n", type, badVAddr);
+                    }
+                }
+                break;
+            }
+            case TRACE_SWITCH: {
+                uint32_t process = ReadField(f, delta);
+                uint32_t cpu = ReadField(f, delta);
+                s.switches++;
+                s.current = process;
+                if (o.print && o.kinds[tag]) {
+                    if (process == 0) {
+                        printf("switch process - cpu %u\n", cpu);
+                    } else {
+                        printf("switch process %u cpu %u\n",
+                               process - 1, cpu);
+                    }
+                }
+                break;
+            }
+            default:
+                fprintf(stderr, "%s: unknown record tag %d\n", path, tag);
+                truncated = true;
+                break;
+        }
+        if (truncated) {
+            break;
+        }
+    }
+    fclose(f);
+
+    if (o.summary) {
+        PrintSummary(&s, path, &h);
+    }
+    free(s.processTicks);
+    return truncated ? 1 : 0;
+}
@@ -0,0 +1,59 @@
+/// Data structures defining the format of Nachos execution traces.
+///
+/// A trace is written by the machine simulation when Nachos runs with
+/// `-tr` or `-trd`, and is read back by `readtrace`.  It starts with a
+/// `traceHeader`, followed by a stream of records.  Each record is a tag
+/// byte (`traceTag`) and the fields listed next to the tag.
+///
+/// Fields are encoded in one of two ways, chosen for the whole trace:
+///
+/// * plain: every field is a 32-bit little-endian word, except sizes and
+///   exception types, which take a single byte.
+/// * delta (`TRACE_DELTA`): every field is a variable-length integer, 7
+///   bits per byte with the high bit set on every byte but the last.
+///   Addresses are stored as the difference from the previous one of their
+///   kind, with the sign folded into the low bit (0, -1, 1, -2... become
+///   0, 1, 2, 3...).  Sequential instructions are not recorded one by one,
+///   but counted in `TRACE_STEPS` records.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_BIN_TRACE__H
+#define NACHOS_BIN_TRACE__H
+
+
+#include <stdint.h>
+
+
+#define TRACE_MAGIC    0x4352544E  // "NTRC" when stored in little endian.
+#define TRACE_VERSION  1
+
+#define TRACE_DELTA  0x1  // Fields are delta-encoded.
+
+typedef struct traceHeader {
+    uint32_t magic;    // Should be `TRACE_MAGIC`.
+    uint16_t version;  // Should be `TRACE_VERSION`.
+    uint16_t flags;    // `TRACE_DELTA` or 0.
+} traceHeader;
+
+enum traceTag {
+    TRACE_PC,         // An instruction was run.  Field: its address (in
+                      // delta traces, relative to the address following
+                      // the previous instruction).
+    TRACE_STEPS,      // Delta traces only.  Field: number of instructions
+                      // run, each at the address following the previous.
+    TRACE_LOAD,       // Memory was read.  Fields: size (1 byte), address.
+    TRACE_STORE,      // Memory was written.  Fields: size (1 byte),
+                      // address.
+    TRACE_EXCEPTION,  // The kernel was entered.  Fields: exception type (1
+                      // byte), bad virtual address.
+    TRACE_SWITCH,     // A thread was given a CPU.  Fields: process
+                      // identifier plus one (0 for threads without one),
+                      // CPU.
+    NUM_TRACE_TAGS
+};
+
+
+#endif
@@ -23,9 +23,10 @@ Bitmap::Bitmap(unsigned nitems)
     numBits  = nitems;
     numWords = DivRoundUp(numBits, BITS_IN_WORD);
     map      = new unsigned [numWords];
-    for (unsigned i = 0; i < numBits; i++) {
-        Clear(i);
+    for (unsigned i = 0; i < numWords; i++) {
+        map[i] = 0;
     }
+    firstFree = 0;
 }
 
 /// De-allocate a bitmap.
@@ -52,6 +53,9 @@ Bitmap::Clear(unsigned which)
 {
     ASSERT(which < numBits);
     map[which / BITS_IN_WORD] &= ~(1 << which % BITS_IN_WORD);
+    if (which / BITS_IN_WORD < firstFree) {
+        firstFree = which / BITS_IN_WORD;
+    }
 }
 
 /// Return true if the “nth” bit is set.
@@ -68,11 +72,20 @@ Bitmap::Test(unsigned which) const
 /// the bit (mark it as in use).  (In other words, find and allocate a bit.)
 ///
 /// If no bits are clear, return -1.
+///
+/// The search goes a word at a time, starting from the first word that may
+/// have a clear bit, so that allocating every bit of a large bitmap one by
+/// one does not take quadratic time.
 int
 Bitmap::Find()
 {
-    for (unsigned i = 0; i < numBits; i++) {
-        if (!Test(i)) {
+    for (; firstFree < numWords; firstFree++) {
+        unsigned clear = ~map[firstFree];
+        if (clear != 0) {
+            unsigned i = firstFree * BITS_IN_WORD + __builtin_ctz(clear);
+            if (i >= numBits) {
+                break;  // Only the padding of the last word is clear.
+            }
             Mark(i);
             return i;
         }
@@ -87,12 +100,11 @@ Bitmap::CountClear() const
 {
     unsigned count = 0;
 
-    for (unsigned i = 0; i < numBits; i++) {
-        if (!Test(i)) {
-            count++;
-        }
+    for (unsigned i = 0; i < numWords; i++) {
+        count += __builtin_popcount(~map[i]);
     }
-    return count;
+    // Do not count the padding at the end of the last word.
+    return count - (numWords * BITS_IN_WORD - numBits);
 }
 
 /// Print the contents of the bitmap, for debugging.
@@ -121,6 +133,7 @@ Bitmap::FetchFrom(OpenFile *file)
 {
     ASSERT(file != nullptr);
     file->ReadAt((char *) map, numWords * sizeof (unsigned), 0);
+    firstFree = 0;
 }
 
 /// Store the contents of a bitmap to a Nachos file.
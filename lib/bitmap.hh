@@ -85,6 +85,10 @@ private:
     /// Bit storage.
     unsigned *map;
 
+    /// Index of the first word of `map` that may have a clear bit; every
+    /// word before it is known to be full.
+    unsigned firstFree;
+
 };
 
 
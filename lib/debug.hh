@@ -16,6 +16,17 @@
 /// * `e` -- exception handling (requires *USER_PROGRAM*).
 /// * `n` -- network emulation (requires *NETWORK*).
 ///
+/// Flags are letters and digits; any other character stands for all of
+/// them but `+`.  Which flags are enabled is kept as a bit mask, so that
+/// checking a flag costs a shift and a test.
+///
+/// Debug messages can also be compiled out: if `DEBUG_FLAGS` is defined
+/// (for example with `-DDEBUG_FLAGS='"ae"'` in `DEFINES`), only the flags
+/// it lists are compiled in, and `-DDEBUG_FLAGS='""'` leaves none.  Every
+/// check for a flag that is not compiled in, whether through `DEBUG` or
+/// `IsEnabled`, is then a constant false, and the compiler drops the code
+/// it guards.  By default every flag is compiled in.
+///
 /// See also `debug_opts.hh`.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
@@ -30,6 +41,35 @@
 
 #include "debug_opts.hh"
 
+#include <stdint.h>
+
+
+/// Bit of the debug mask that stands for `flag`.
+constexpr unsigned
+DebugBit(char flag)
+{
+    return 'a' <= flag && flag <= 'z' ? flag - 'a'
+         : 'A' <= flag && flag <= 'Z' ? flag - 'A' + 26
+         : '0' <= flag && flag <= '9' ? flag - '0' + 52
+         : 62;
+}
+
+/// Debug mask with the bits of every flag in `flags` set.
+constexpr uint64_t
+DebugMask(const char *flags)
+{
+    return *flags == '\0' ? 0
+         : *flags == '+'  ? ~(uint64_t) 0
+         : (uint64_t) 1 << DebugBit(*flags) | DebugMask(flags + 1);
+}
+
+/// Flags whose debug messages are compiled in.
+#ifdef DEBUG_FLAGS
+constexpr uint64_t COMPILED_DEBUG_MASK = DebugMask(DEBUG_FLAGS);
+#else
+constexpr uint64_t COMPILED_DEBUG_MASK = ~(uint64_t) 0;
+#endif
+
 
 /// Interface to debugging routines.
 class Debug {
@@ -39,8 +79,25 @@ public:
     /// printed until `SetFlags` is called.
     Debug();
 
+    /// Are the debug messages of this flag compiled in?
+    static constexpr bool IsCompiledIn(char flag)
+    {
+        return (COMPILED_DEBUG_MASK >> DebugBit(flag) & 1) != 0;
+    }
+
     /// Is this debug flag enabled?
-    bool IsEnabled(char flag) const;
+    bool IsEnabled(char flag) const
+    {
+        return IsCompiledIn(flag) && (mask >> DebugBit(flag) & 1) != 0;
+    }
+
+    /// Is any of the flags whose bits are set in `bits` enabled?
+    ///
+    /// Used by `DEBUG`, which works the bits out at compile time.
+    bool AreEnabled(uint64_t bits) const
+    {
+        return (mask & bits) != 0;
+    }
 
     /// Get the current flags.
     const char *GetFlags() const;
@@ -76,8 +133,21 @@ private:
     /// String that controls which debug messages are printed.
     const char *flags;
 
+    /// The flags in `flags`, one bit each.
+    uint64_t mask;
+
     DebugOpts opts;
 };
 
+/// What is known about the debug flag `FLAG` at compile time.
+///
+/// Spelled out as constants so that they are folded even when building
+/// without optimizations.
+template <char FLAG>
+struct DebugFlag {
+    static constexpr bool COMPILED_IN = Debug::IsCompiledIn(FLAG);
+    static constexpr uint64_t BIT = (uint64_t) 1 << DebugBit(FLAG);
+};
+
 
 #endif
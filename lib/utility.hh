@@ -66,8 +66,19 @@ typedef void (*VoidNoArgFunctionPtr)();
 /// Global object for debug output.
 extern Debug debug;
 
-#define DEBUG(...)  (debug.Print)(__FILE__, __LINE__, __func__, __VA_ARGS__)
-#define DEBUG_CONT  (debug.PrintCont)
+/// Print a debug message, if its flag is enabled.
+///
+/// The flag, which must be a character literal, is checked before the
+/// arguments are evaluated, so a disabled message costs a bit test, and one
+/// that is not compiled in costs nothing.
+#define DEBUG_ENABLED(flag)                                               \
+    (DebugFlag<flag>::COMPILED_IN && debug.AreEnabled(DebugFlag<flag>::BIT))
+#define DEBUG(flag, ...)                                                  \
+    (DEBUG_ENABLED(flag)                                                  \
+     ? (debug.Print)(__FILE__, __LINE__, __func__, flag, __VA_ARGS__)     \
+     : (void) 0)
+#define DEBUG_CONT(flag, ...)                                             \
+    (DEBUG_ENABLED(flag) ? (debug.PrintCont)(flag, __VA_ARGS__) : (void) 0)
 
 
 #endif
@@ -0,0 +1,75 @@
+/// Routines to manage the cache of decoded user instructions.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "decode_cache.hh"
+#include "endianness.hh"
+#include "lib/utility.hh"
+
+#include <string.h>
+
+
+DecodeCache::DecodeCache(unsigned frames, unsigned frameSize)
+{
+    ASSERT(frameSize >= 4 && (frameSize & (frameSize - 1)) == 0);
+
+    numFrames     = frames;
+    wordsPerFrame = frameSize / 4;
+    for (frameShift = 0; 1U << frameShift < frameSize; frameShift++) {}
+    instructions  = new Instruction * [numFrames];
+    decoded       = new bool * [numFrames];
+    for (unsigned i = 0; i < numFrames; i++) {
+        instructions[i] = nullptr;
+        decoded[i]      = nullptr;
+    }
+}
+
+DecodeCache::~DecodeCache()
+{
+    for (unsigned i = 0; i < numFrames; i++) {
+        delete [] instructions[i];
+        delete [] decoded[i];
+    }
+    delete [] instructions;
+    delete [] decoded;
+}
+
+const Instruction *
+DecodeCache::Fetch(const char *memory, unsigned physAddr)
+{
+    ASSERT(memory != nullptr);
+    ASSERT((physAddr & 0x3) == 0);
+
+    unsigned frame = physAddr >> frameShift;
+    unsigned index = (physAddr & ((1U << frameShift) - 1)) / 4;
+    ASSERT(frame < numFrames);
+
+    if (decoded[frame] == nullptr) {
+        // First instruction fetched from this frame.
+        instructions[frame] = new Instruction [wordsPerFrame];
+        decoded[frame]      = new bool [wordsPerFrame];
+        memset(decoded[frame], 0, wordsPerFrame * sizeof (bool));
+    }
+
+    Instruction *instr = &instructions[frame][index];
+    if (!decoded[frame][index]) {
+        instr->value = WordToHost(*(const unsigned *) &memory[physAddr]);
+        instr->Decode();
+        decoded[frame][index] = true;
+    }
+    return instr;
+}
+
+void
+DecodeCache::InvalidateFrame(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+
+    if (decoded[frame] != nullptr) {
+        memset(decoded[frame], 0, wordsPerFrame * sizeof (bool));
+    }
+}
@@ -0,0 +1,73 @@
+/// Data structures for caching decoded user instructions.
+///
+/// Fetching an instruction used to mean reading a word of `mainMemory` and
+/// decoding it again, every single time, even inside tight loops.  The
+/// decode cache keeps the already decoded `Instruction` record of every
+/// word of physical memory, so that decoding only happens the first time a
+/// word is fetched after it changed.
+///
+/// The cache is indexed by physical address, so it is shared by every
+/// address space, and it does not need to be flushed on a context switch.
+/// Only frames from which instructions are fetched get their records
+/// allocated, so that large memories mostly holding data stay cheap.
+/// It must be told, however, whenever the contents of a frame change:
+/// * the MMU invalidates a single word on each simulated store;
+/// * the kernel invalidates a whole frame when it fills it without going
+///   through the MMU (loading a page, or evicting it to reuse the frame).
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_DECODECACHE__HH
+#define NACHOS_MACHINE_DECODECACHE__HH
+
+
+#include "instruction.hh"
+
+
+class DecodeCache {
+public:
+
+    /// Initialize an empty cache for `numFrames` frames of `frameSize`
+    /// bytes each; `frameSize` must be a power of two.
+    DecodeCache(unsigned numFrames, unsigned frameSize);
+
+    /// De-allocate the cache.
+    ~DecodeCache();
+
+    /// Return the decoded instruction stored at `physAddr`, decoding it
+    /// from `memory` first if there is no valid copy.
+    ///
+    /// `physAddr` must be word aligned.
+    const Instruction *Fetch(const char *memory, unsigned physAddr);
+
+    /// Forget the decoded copy of the word containing `physAddr`.
+    void InvalidateWord(unsigned physAddr)
+    {
+        bool *frame = decoded[physAddr >> frameShift];
+        if (frame != nullptr) {
+            frame[(physAddr & ((1U << frameShift) - 1)) / 4] = false;
+        }
+    }
+
+    /// Forget every decoded copy of words in `frame`.
+    void InvalidateFrame(unsigned frame);
+
+private:
+
+    unsigned numFrames;
+    unsigned wordsPerFrame;
+    unsigned frameShift;  ///< Base 2 logarithm of the frame size.
+
+    /// Decoded instructions of each frame, one per word, or null if no
+    /// instruction was ever fetched from the frame.
+    Instruction **instructions;
+
+    /// Whether the corresponding entry of `instructions` is up to date.
+    bool **decoded;
+};
+
+
+#endif
@@ -9,6 +9,11 @@
 /// Simulated machine byte ordering
 ///     Main memory.
 ///
+/// The conversions are inline, and chosen at compile time, so that on
+/// little-endian hosts every access to simulated memory is a plain load or
+/// store.  Big-endian hosts are detected from the compiler when it tells,
+/// or can be forced with `HOST_IS_BIG_ENDIAN` (see `Makefile.env`).
+///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
 /// All rights reserved.  See `copyright.h` for copyright notice and
@@ -18,10 +23,51 @@
 #define NACHOS_MACHINE_ENDIANNESS__HH
 
 
-unsigned WordToHost(unsigned word);
-unsigned short ShortToHost(unsigned short shortword);
-unsigned WordToMachine(unsigned word);
-unsigned short ShortToMachine(unsigned short shortword);
+#if !defined(HOST_IS_BIG_ENDIAN) && defined(__BYTE_ORDER__) \
+    && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_IS_BIG_ENDIAN
+#endif
+
+
+inline unsigned
+WordToHost(unsigned word)
+{
+#ifdef HOST_IS_BIG_ENDIAN
+    unsigned result;
+    result  = word >> 24 & 0x000000FF;
+    result |= word >>  8 & 0x0000FF00;
+    result |= word <<  8 & 0x00FF0000;
+    result |= word << 24 & 0xFF000000;
+    return result;
+#else
+    return word;
+#endif
+}
+
+inline unsigned short
+ShortToHost(unsigned short shortword)
+{
+#ifdef HOST_IS_BIG_ENDIAN
+    unsigned short result;
+    result  = shortword << 8 & 0xFF00;
+    result |= shortword >> 8 & 0x00FF;
+    return result;
+#else
+    return shortword;
+#endif
+}
+
+inline unsigned
+WordToMachine(unsigned word)
+{
+    return WordToHost(word);
+}
+
+inline unsigned short
+ShortToMachine(unsigned short shortword)
+{
+    return ShortToHost(shortword);
+}
 
 
 #endif
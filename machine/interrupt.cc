@@ -21,6 +21,7 @@
 
 
 #include "interrupt.hh"
+#include "pending_queue.hh"
 #include "threads/system.hh"
 
 #include <limits.h>
@@ -32,7 +33,7 @@
 static const char *INT_LEVEL_NAMES[] = { "disabled", "enabled" };
 static const char *INT_TYPE_NAMES[]  = {
     "timer", "disk", "console write", "console read",
-    "network send", "network recv"
+    "network send", "network recv", "checkpoint"
 };
 
 static inline bool
@@ -64,6 +65,7 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, void *param,
     arg     = param;
     when    = time;
     type    = kind;
+    order   = 0;
 }
 
 /// Initialize the simulation of hardware device interrupts.
@@ -72,18 +74,20 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, void *param,
 Interrupt::Interrupt()
 {
     level         = INT_OFF;
-    pending       = new List<PendingInterrupt *>;
+    pending       = new PendingQueue;
     inHandler     = false;
     yieldOnReturn = false;
     status        = SYSTEM_MODE;
+    interruptedStatus = SYSTEM_MODE;
+    sliceEnd      = ULONG_MAX;
+    roundStart    = 0;
+    roundEnd      = 0;
+    behind        = 0;
 }
 
 /// De-allocate the data structures needed by the interrupt simulation.
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty()) {
-        delete pending->Pop();
-    }
     delete pending;
 }
 
@@ -143,25 +147,32 @@ Interrupt::Enable()
 /// Two things can cause `OneTick` to be called:
 /// * interrupts are re-enabled;
 /// * a user instruction is executed.
-void
+///
+/// Returns true if any interrupt handler was invoked, or if another CPU ran
+/// in between, so that the machine simulation knows that the kernel may
+/// have run meanwhile.
+bool
 Interrupt::OneTick()
 {
     MachineStatus old = status;
 
     // Advance simulated time.
     if (status == SYSTEM_MODE) {
-        stats->totalTicks += SYSTEM_TICK;
+        Advance(SYSTEM_TICK);
         stats->systemTicks += SYSTEM_TICK;
     } else {  // USER_PROGRAM
-        stats->totalTicks += USER_TICK;
+        Advance(USER_TICK);
         stats->userTicks += USER_TICK;
     }
-    DEBUG('i', "== Tick %u ==\n", stats->totalTicks);
+    DEBUG('i', "== Tick %lu ==\n", Now());
 
     // Check any pending interrupts are now ready to fire.
     ChangeLevel(INT_ON, INT_OFF);  // First, turn off interrupts (interrupt
                                    // handlers run with interrupts disabled).
-    while (CheckIfDue(false)) {}   // Check for pending interrupts.
+    bool fired = false;
+    while (CheckIfDue(false)) {    // Check for pending interrupts.
+        fired = true;
+    }
     ChangeLevel(INT_OFF, INT_ON);  // Re-enable interrupts.
     if (yieldOnReturn) {           // If the timer device handler asked for a
                                    // context switch, ok to do it now.
@@ -170,6 +181,64 @@ Interrupt::OneTick()
         currentThread->Yield();
         status = old;
     }
+    if (Now() >= sliceEnd) {  // Let the next CPU run.
+        status = SYSTEM_MODE;
+        scheduler->SwitchCpu();
+        status = old;
+        fired = true;
+    }
+    return fired;
+}
+
+/// Return the number of ticks left until the earliest pending interrupt is
+/// due (zero if it is already overdue), or `ULONG_MAX` if nothing is
+/// pending.
+///
+/// The pending list is kept sorted, so this is just a look at its head.
+/// The end of the current CPU slice counts as an interrupt.
+unsigned long
+Interrupt::TicksUntilDue() const
+{
+    unsigned long when = sliceEnd;
+    if (!pending->IsEmpty() && pending->Head()->when < when) {
+        when = pending->Head()->when;
+    }
+    if (when == ULONG_MAX) {
+        return ULONG_MAX;
+    }
+    unsigned long now = Now();
+    return when > now ? when - now : 0;
+}
+
+/// Charge the ticks of `count` user instructions in one step.
+///
+/// This is what `count` calls to `OneTick` in user mode would do, given that
+/// no interrupt was due in between, so that there is nothing else to check.
+void
+Interrupt::ChargeUserTicks(unsigned long count)
+{
+    ASSERT(status == USER_MODE);
+    ASSERT(count * USER_TICK < TicksUntilDue());
+
+    Advance(count * USER_TICK);
+    stats->userTicks += count * USER_TICK;
+}
+
+unsigned long
+Interrupt::Now() const
+{
+    return stats->totalTicks - behind;
+}
+
+void
+Interrupt::Advance(unsigned long ticks)
+{
+    if (behind >= ticks) {
+        behind -= ticks;
+    } else {
+        stats->totalTicks += ticks - behind;
+        behind = 0;
+    }
 }
 
 /// Called from within an interrupt handler, to cause a context switch (for
@@ -185,6 +254,32 @@ Interrupt::YieldOnReturn()
     yieldOnReturn = true;
 }
 
+/// Rewinding the clock for every slice of a round is what makes the CPUs
+/// run in parallel in simulated time: a round takes as long as its longest
+/// slice, not as long as all of them together.  The clock skips ahead at
+/// the start of a round, and the ticks skipped are charged as idle time.
+///
+/// The total ticks are always the end of the latest slice so far, which no
+/// slice of the round can be before, so the rewound clock is kept as how
+/// far behind them it is.
+void
+Interrupt::StartSlice(unsigned long length, bool newRound)
+{
+    ASSERT(length > 0);
+
+    unsigned long now = Now();
+    if (now > roundEnd) {
+        roundEnd = now;
+    }
+    if (newRound) {
+        stats->idleTicks += roundEnd - now;
+        roundStart = roundEnd;
+    }
+    ASSERT(stats->totalTicks >= roundStart);
+    behind = stats->totalTicks - roundStart;
+    sliceEnd = roundStart + length;
+}
+
 /// Routine called when there is nothing in the ready queue.
 ///
 /// Since something has to be running in order to put a thread on the ready
@@ -234,23 +329,21 @@ Interrupt::Halt()
 /// tick counter.  After some time (when `totalTicks` reach the maximum
 /// positive number) Nachos would schedule a pending interrupt at a negative
 /// time, and after that, it would hang.
+///
+/// The clock of the CPU being simulated goes back to 0, and everything else
+/// as much, which is the only time `totalTicks` decreases.
 void
 Interrupt::RestartTicks()
 {
-    List<PendingInterrupt *> *oldPending = pending;
-    pending = new List<PendingInterrupt *>;
-
-    PendingInterrupt *i;
-    unsigned          oldWhen = 0;
-    while ((i = oldPending->SortedPop((int *) &oldWhen)) != nullptr) {
-        unsigned newWhen = oldWhen - stats->totalTicks;
-        pending->SortedInsert(i, newWhen);
-        DEBUG('x', "Interrupt at time %u re-scheduled at new time %u.\n",
-              oldWhen, newWhen);
+    unsigned long now = Now();
+    DEBUG('x', "Pending interrupts re-scheduled %lu ticks earlier.\n", now);
+    pending->Shift(now);
+    roundStart = roundStart > now ? roundStart - now : 0;
+    roundEnd = roundEnd > now ? roundEnd - now : 0;
+    if (sliceEnd != ULONG_MAX) {
+        sliceEnd = sliceEnd > now ? sliceEnd - now : 0;
     }
-
-    delete oldPending;
-    stats->totalTicks = 0;
+    stats->totalTicks -= now;
     stats->tickResets += 1;
 }
 #endif
@@ -258,7 +351,7 @@ Interrupt::RestartTicks()
 /// Arrange for the CPU to be interrupted when simulated time reaches `now +
 /// when`.
 ///
-/// Implementation: just put it on a sorted list.
+/// Implementation: just put it on the pending queue.
 ///
 /// NOTE: the Nachos kernel should not call this routine directly.  Instead,
 /// it is only called by the hardware device simulators.
@@ -287,14 +380,12 @@ Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
     ASSERT(ULONG_MAX - stats->totalTicks > fromNow);
 #endif
 
-    unsigned when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg,
-                                                     when, type);
+    unsigned long when = Now() + fromNow;
 
-    DEBUG('i', "Scheduling interrupt handler the %s at time = %u\n",
+    DEBUG('i', "Scheduling interrupt handler the %s at time = %lu\n",
           INT_TYPE_NAMES[type], when);
 
-    pending->SortedInsert(toOccur, when);
+    pending->Insert(handler, arg, when, type);
 }
 
 /// Check if an interrupt is scheduled to occur, and if so, fire it off.
@@ -309,35 +400,39 @@ bool
 Interrupt::CheckIfDue(bool advanceClock)
 {
     MachineStatus old = status;
-    unsigned      when;
 
     ASSERT(level == INT_OFF);  // Interrupts need to be disabled, to invoke
                                // an interrupt handler.
     if (debug.IsEnabled('i')) {
         DumpState();
     }
-    PendingInterrupt *toOccur = pending->SortedPop((int *) &when);
-
-    if (toOccur == nullptr) {  // No pending interrupts.
+    if (pending->IsEmpty()) {  // No pending interrupts.
         return false;
     }
 
-    if (advanceClock && when > stats->totalTicks) {  // Advance the clock.
-        stats->idleTicks += (when - stats->totalTicks);
-        stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {  // Not time yet, put it back.
-        pending->SortedInsert(toOccur, when);
+    // Not time yet.  The list is left untouched, so that interrupts due at
+    // the same tick fire in the order they were scheduled, no matter how
+    // many times they were checked before.
+    if (!advanceClock && pending->Head()->when > Now()) {
         return false;
     }
 
+    PendingInterrupt *toOccur = pending->Pop();
+    unsigned long when = toOccur->when;
+    if (advanceClock && when > Now()) {  // Advance the clock.
+        stats->idleTicks += (when - Now());
+        Advance(when - Now());
+    }
+
     // Check if there is nothing more to do, and if so, quit.
     if (status == IDLE_MODE && toOccur->type == TIMER_INT
           && pending->IsEmpty()) {
-        pending->SortedInsert(toOccur, when);
+        pending->Insert(toOccur->handler, toOccur->arg, when, toOccur->type);
+        pending->Release(toOccur);
         return false;
     }
 
-    DEBUG('i', "Invoking interrupt handler for the %s at time %u\n",
+    DEBUG('i', "Invoking interrupt handler for the %s at time %lu\n",
             INT_TYPE_NAMES[toOccur->type], toOccur->when);
 #ifdef USER_PROGRAM
     if (machine != nullptr) {
@@ -345,12 +440,13 @@ Interrupt::CheckIfDue(bool advanceClock)
     }
 #endif
     inHandler = true;
+    interruptedStatus = old;
     status = SYSTEM_MODE;  // Whatever we were doing, we are now going to be
                            // running in the kernel.
     (*toOccur->handler)(toOccur->arg);  // Call the interrupt handler.
     status = old;  // Restore the machine status.
     inHandler = false;
-    delete toOccur;
+    pending->Release(toOccur);
     return true;
 }
 
@@ -366,6 +462,13 @@ Interrupt::GetStatus() const
     return status;
 }
 
+MachineStatus
+Interrupt::GetInterruptedStatus() const
+{
+    ASSERT(inHandler);
+    return interruptedStatus;
+}
+
 void
 Interrupt::SetStatus(MachineStatus st)
 {
@@ -389,7 +492,7 @@ void
 Interrupt::DumpState()
 {
     printf("Time: %lu, interrupts %s\n",
-           stats->totalTicks, INT_LEVEL_NAMES[level]);
+           Now(), INT_LEVEL_NAMES[level]);
     if (pending->IsEmpty()) {
         printf("No pending interrupts\n");
     } else {
@@ -36,7 +36,7 @@
 #define NACHOS_MACHINE_INTERRUPT__HH
 
 
-#include "lib/list.hh"
+#include "lib/utility.hh"
 
 
 /// Interrupts can be disabled (`INT_OFF`) or enabled (`INT_ON`).
@@ -58,7 +58,8 @@ enum MachineStatus {
 
 /// `IntType` records which hardware device generated an interrupt.  In
 /// Nachos, we support a hardware timer device, a disk, a console display and
-/// keyboard, and a network.
+/// keyboard, and a network.  Checkpoints are also taken from an interrupt,
+/// at the tick they are asked for.
 enum IntType {
     TIMER_INT,
     DISK_INT,
@@ -66,6 +67,7 @@ enum IntType {
     CONSOLE_READ_INT,
     NETWORK_SEND_INT,
     NETWORK_RECV_INT,
+    CHECKPOINT_INT,
     NUM_INT_TYPES
 };
 
@@ -87,8 +89,12 @@ public:
     void *arg;  ///< The argument to the function.
     unsigned long when;  ///< When the interrupt is supposed to fire.
     IntType type;  ///< For debugging.
+    unsigned long order;  ///< When it was scheduled, relative to other
+                          ///< interrupts due at the same time.
 };
 
+class PendingQueue;
+
 /// The following class defines the data structures for the simulation
 /// of hardware interrupts.
 ///
@@ -122,9 +128,26 @@ public:
     // Cause a context switch on return from an interrupt handler.
     void YieldOnReturn();
 
+    /// Start a time slice of `length` ticks on another simulated CPU.
+    ///
+    /// Simulated CPUs run in parallel, but they are simulated one after
+    /// the other, a slice each, in rounds.  Every slice of a round starts
+    /// at the time the round started; when a new round starts (`newRound`),
+    /// the clock moves on to the end of the latest slice of the previous
+    /// one.  When the slice is over, `Scheduler::SwitchCpu` is called.
+    ///
+    /// Only the clock of the CPU being simulated goes back to the start of
+    /// the round; `stats->totalTicks` stays at the latest time any CPU has
+    /// reached, so it never decreases (but see `RestartTicks`).
+    void StartSlice(unsigned long length, bool newRound);
+
     // Idle, kernel, user.
     MachineStatus GetStatus() const;
 
+    /// Return the status the machine was in when the interrupt handler
+    /// being run was invoked (handlers themselves run in kernel mode).
+    MachineStatus GetInterruptedStatus() const;
+
     void SetStatus(MachineStatus st);
 
     // Print interrupt state.
@@ -143,19 +166,55 @@ public:
                   unsigned long when, IntType type);
 
     /// Advance simulated time.
-    void OneTick();
+    ///
+    /// Return true if any interrupt handler was invoked.
+    bool OneTick();
+
+    /// Return how many ticks may go by before the next pending interrupt
+    /// comes due, or `ULONG_MAX` if there is none.
+    unsigned long TicksUntilDue() const;
+
+    /// Advance simulated time by `count` user instructions at once, without
+    /// checking for pending interrupts.
+    ///
+    /// The caller must make sure that no interrupt comes due meanwhile (see
+    /// `TicksUntilDue`).
+    void ChargeUserTicks(unsigned long count);
 
 private:
     IntStatus level;  ///< Are interrupts enabled or disabled?
-    List<PendingInterrupt *> *pending;  ///< The list of interrupts scheduled
-                                        ///< to occur in the future.
+    PendingQueue *pending;  ///< The interrupts scheduled to occur in the
+                            ///< future.
     bool inHandler;  ///< True if we are running an interrupt handler.
     bool yieldOnReturn;  ///< True if we are to context switch on return from
                          ///< the interrupt handler.
     MachineStatus status;  ///< Idle, kernel mode, user mode.
+    MachineStatus interruptedStatus;  ///< Status before the current
+                                      ///< interrupt handler was invoked.
+
+    /// Time at which the slice of the current CPU ends, or `ULONG_MAX` if
+    /// there is a single CPU.
+    unsigned long sliceEnd;
+
+    /// Time at which the current round of CPU slices started, and at which
+    /// the latest of its slices ended so far.
+    unsigned long roundStart;
+    unsigned long roundEnd;
+
+    /// How far the clock of the CPU being simulated is behind
+    /// `stats->totalTicks`.  Always 0 with a single CPU.
+    unsigned long behind;
 
     /// These functions are internal to the interrupt simulation code.
 
+    /// Return the time on the clock of the CPU being simulated, which
+    /// pending interrupts and slices are measured against.
+    unsigned long Now() const;
+
+    /// Move the clock of the CPU being simulated `ticks` forward, and
+    /// `stats->totalTicks` with it once it catches up.
+    void Advance(unsigned long ticks);
+
     /// Check if an interrupt is supposed to occur now.
     bool CheckIfDue(bool advanceClock);
 
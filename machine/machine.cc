@@ -9,8 +9,11 @@
 
 
 #include "machine.hh"
+#include "endianness.hh"
 #include "threads/system.hh"
 
+#include <string.h>
+
 
 static inline bool
 IsExceptionType(ExceptionType t)
@@ -45,10 +48,22 @@ CheckEndian()
 /// * `st` -- pointer to an object that performs single stepping, for
 ///   dropping into it after each user instruction is executed; if null,
 ///   execute normally, without single stepping.
-Machine::Machine(SingleStepper *st)
+/// * `threaded` -- whether to run user code with the threaded-code engine.
+/// * `burst` -- whether to charge simulated time in bursts.
+/// * `cpus` -- number of simulated CPUs.
+Machine::Machine(SingleStepper *st, bool threaded, bool burst,
+                 unsigned cpus)
 {
-    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
-        registers[i] = 0;
+    ASSERT(cpus > 0);
+
+    numCpus = cpus;
+    registerBanks = new int [numCpus * NUM_TOTAL_REGS];
+    for (unsigned i = 0; i < numCpus * NUM_TOTAL_REGS; i++) {
+        registerBanks[i] = 0;
+    }
+    registers = registerBanks;
+    if (numCpus > 1) {
+        mmu.SetNumCpus(numCpus);
     }
 
     for (unsigned i = 0; i < NUM_EXCEPTION_TYPES; i++) {
@@ -56,9 +71,54 @@ Machine::Machine(SingleStepper *st)
     }
 
     singleStepper = st;
+    threadedDispatch = threaded;
+    profiler = nullptr;
+    tracer = nullptr;
+    burstMode = burst;
+    burstLeft = 0;
+    unchargedTicks = 0;
+    kernelAccess = false;
     CheckEndian();
 }
 
+Machine::~Machine()
+{
+    if (profiler != nullptr) {
+        profiler->WriteReport();
+        delete profiler;
+    }
+    delete tracer;
+    delete [] registerBanks;
+}
+
+/// Switching CPUs is only done by the kernel, on a tick, once the current
+/// burst has been charged.  A delayed load in flight stays in the registers
+/// of its CPU.
+void
+Machine::SelectCpu(unsigned cpu)
+{
+    ASSERT(cpu < numCpus);
+
+    registers = &registerBanks[cpu * NUM_TOTAL_REGS];
+    mmu.SelectCpu(cpu);
+}
+
+void
+Machine::StartProfiling(const char *reportName, const char *symbolName)
+{
+    ASSERT(profiler == nullptr);
+
+    profiler = new Profiler(reportName, symbolName);
+}
+
+void
+Machine::StartTracing(const char *fileName, bool delta)
+{
+    ASSERT(tracer == nullptr);
+
+    tracer = new TraceRecorder(fileName, delta);
+}
+
 const int *
 Machine::GetRegisters() const
 {
@@ -99,6 +159,9 @@ Machine::ReadMem(unsigned addr, unsigned size, int *value)
         RaiseException(e, addr);
         return false;
     }
+    if (tracer != nullptr) {
+        tracer->RecordAccess(false, addr, size);
+    }
     return true;
 }
 
@@ -110,9 +173,102 @@ Machine::WriteMem(unsigned addr, unsigned size, int value)
         RaiseException(e, addr);
         return false;
     }
+    if (tracer != nullptr) {
+        tracer->RecordAccess(true, addr, size);
+    }
+    return true;
+}
+
+/// Times a page may fault during a block copy before giving up.
+static const unsigned MAX_SPAN_TRIES = 5;
+
+bool
+Machine::MapSpan(unsigned addr, unsigned size, bool writing,
+                 char **host, unsigned *length)
+{
+    for (unsigned i = 0; i < MAX_SPAN_TRIES; i++) {
+        ExceptionType e = mmu.MapSpan(addr, size, writing, host, length);
+        if (e == NO_EXCEPTION) {
+            if (tracer != nullptr) {
+                tracer->RecordAccess(writing, addr, *length);
+            }
+            return true;
+        }
+        kernelAccess = true;
+        RaiseException(e, addr);
+        kernelAccess = false;
+    }
+    return false;
+}
+
+bool
+Machine::IsKernelAccess() const
+{
+    return kernelAccess;
+}
+
+bool
+Machine::ReadBlock(unsigned addr, char *into, unsigned size)
+{
+    ASSERT(into != nullptr);
+
+    while (size > 0) {
+        char *host;
+        unsigned length;
+        if (!MapSpan(addr, size, false, &host, &length)) {
+            return false;
+        }
+        memcpy(into, host, length);
+        addr += length;
+        into += length;
+        size -= length;
+    }
     return true;
 }
 
+bool
+Machine::WriteBlock(unsigned addr, const char *from, unsigned size)
+{
+    ASSERT(from != nullptr);
+
+    while (size > 0) {
+        char *host;
+        unsigned length;
+        if (!MapSpan(addr, size, true, &host, &length)) {
+            return false;
+        }
+        memcpy(host, from, length);
+        addr += length;
+        from += length;
+        size -= length;
+    }
+    return true;
+}
+
+bool
+Machine::ReadString(unsigned addr, char *into, unsigned maxSize)
+{
+    ASSERT(into != nullptr);
+
+    while (maxSize > 0) {
+        char *host;
+        unsigned length;
+        if (!MapSpan(addr, maxSize, false, &host, &length)) {
+            return false;
+        }
+        const char *end = (const char *) memchr(host, '\0', length);
+        if (end != nullptr) {
+            memcpy(into, host, end - host + 1);
+            return true;
+        }
+        memcpy(into, host, length);
+        addr    += length;
+        into    += length;
+        maxSize -= length;
+    }
+    return false;
+}
+
 /// Transfer control to the Nachos kernel from user mode, because the user
 /// program either invoked a system call, or some exception occured (such as
 /// the address translation failed).
@@ -126,15 +282,27 @@ Machine::RaiseException(ExceptionType et, unsigned badVAddr)
     ASSERT(handlers[et] != nullptr);  // There must be a handler associated.
 
     DEBUG('m', "Exception: %s\n", ExceptionTypeToString(et));
+    if (tracer != nullptr) {
+        tracer->RecordException(et, badVAddr);
+    }
 
     //ASSERT(interrupt->GetStatus() == USER_MODE);
     registers[BAD_VADDR_REG] = badVAddr;
     DelayedLoad(0, 0);  // Finish anything in progress.
 
+    // The kernel may look at the clock or schedule new interrupts, so the
+    // current burst ends here.  The ticks of the instructions before this
+    // one are due now; the one for this instruction is charged by `Tick`.
+    ChargeBurst();
+    burstLeft = 0;
+
     // Call the associated handler with interrupts enabled in system mode.
     interrupt->SetStatus(SYSTEM_MODE);
     (*handlers[et])(et);
     interrupt->SetStatus(USER_MODE);
+
+    // The handler may have changed the page table or the TLB.
+    mmu.FlushTranslations();
 }
 
 void
@@ -23,6 +23,8 @@
 
 #include "exception_type.hh"
 #include "mmu.hh"
+#include "profiler.hh"
+#include "trace_recorder.hh"
 #include "single_stepper.hh"
 #include "lib/utility.hh"
 
@@ -68,13 +70,52 @@ class Machine {
 public:
 
     /// Initialize the simulation of the hardware for running user programs.
-    Machine(SingleStepper *st);
+    ///
+    /// If `threaded` is true, user code is run by the threaded-code engine
+    /// (see `mips_threaded.cc`) instead of the `ExecInstruction` switch.
+    ///
+    /// If `burst` is true, simulated time is charged in bursts that end at
+    /// the next interrupt deadline, instead of after every instruction (see
+    /// `Tick`).
+    ///
+    /// The machine has `cpus` CPUs, each with its own registers and TLB,
+    /// that share the physical memory.
+    Machine(SingleStepper *st, bool threaded = false, bool burst = false,
+            unsigned cpus = 1);
+
+    ~Machine();
 
     /// Routines callable by the Nachos kernel.
 
     /// Run a user program.
     void Run();
 
+    /// Make CPU `cpu` the one being simulated: from now on, user code runs
+    /// with its registers and its TLB.
+    void SelectCpu(unsigned cpu);
+
+    /// Count every user instruction run from now on, and write a profile
+    /// to the file `reportName` when the machine is deleted.
+    ///
+    /// `symbolName` is the COFF file of the program, used to name its
+    /// functions in the report; it may be null.
+    void StartProfiling(const char *reportName, const char *symbolName);
+
+    /// Record a binary trace of user execution in the file `fileName`,
+    /// until the machine is deleted (see `bin/trace.h`).
+    ///
+    /// If `delta` is true, the trace is delta-encoded.
+    void StartTracing(const char *fileName, bool delta);
+
+    /// Record in the trace, if any, that the thread of process `pid` was
+    /// given CPU `cpu`.
+    void TraceSwitch(int pid, unsigned cpu)
+    {
+        if (tracer != nullptr) {
+            tracer->RecordSwitch(pid, cpu);
+        }
+    }
+
     const int *GetRegisters() const;
 
     MMU *GetMMU();
@@ -92,6 +133,42 @@ public:
 
     bool WriteMem(unsigned addr, unsigned size, int value);
 
+    /// Copy `size` bytes between virtual memory at `addr` and a kernel
+    /// buffer, a page at a time, with `memcpy`.
+    ///
+    /// Exceptions are raised as by `ReadMem` and `WriteMem`, and the page
+    /// is tried again, so that page faults can be served on the way.
+    /// Return false if some page could still not be accessed after a few
+    /// tries.
+
+    bool ReadBlock(unsigned addr, char *into, unsigned size);
+
+    bool WriteBlock(unsigned addr, const char *from, unsigned size);
+
+    /// Copy a null-terminated string of at most `maxSize` bytes (the null
+    /// included) from virtual memory at `addr` into `into`.
+    ///
+    /// Return false if no null was found in the first `maxSize` bytes, or
+    /// some page could not be accessed.
+    bool ReadString(unsigned addr, char *into, unsigned maxSize);
+
+    /// Find where up to `size` bytes of virtual memory at `addr` are in
+    /// host memory, with `MMU::MapSpan`, so that the kernel can move data
+    /// straight into or out of them.
+    ///
+    /// Exceptions are raised and the page tried again, as by the block
+    /// copies.  The span stays valid only until the kernel lets another
+    /// thread run, since the page could then be evicted.
+    bool MapSpan(unsigned addr, unsigned size, bool writing,
+                 char **host, unsigned *length);
+
+    /// Tell whether the exception being handled was raised by `MapSpan`,
+    /// on behalf of the kernel, rather than by a user instruction.
+    ///
+    /// Handlers use it to fail the kernel access, instead of punishing the
+    /// process, for faults that cannot be served.
+    bool IsKernelAccess() const;
+
     /// Print the user CPU and memory state.
     void DumpState();
 
@@ -105,6 +182,20 @@ public:
     /// Run a certain instruction of a user program.
     void ExecInstruction(const Instruction *instr);
 
+    /// Run a user program with the threaded-code engine.  Never returns.
+    void RunThreaded();
+
+    /// Advance simulated time after running a user instruction.
+    ///
+    /// Return true if any interrupt handler was invoked.
+    bool Tick();
+
+    /// Charge the instructions run so far in the current burst.
+    void ChargeBurst();
+
+    /// Print an instruction about to be executed, for debugging.
+    void TraceInstruction(const Instruction *instr) const;
+
     /// Do a pending delayed load (modifying a reg).
     void DelayedLoad(unsigned nextReg, int nextVal);
 
@@ -125,12 +216,33 @@ private:
                                    ///< provided object (may be a debugger)
                                    ///< after each simulated instruction.
 
+    bool threadedDispatch;  ///< Use the threaded-code engine.
+
+    Profiler *profiler;  ///< Counts the instructions run, if profiling.
+
+    TraceRecorder *tracer;  ///< Records the execution, if tracing.
+
+    bool burstMode;  ///< Charge simulated time in bursts.
+
+    unsigned long burstLeft;  ///< Instructions that may still run before
+                              ///< the next interrupt comes due.
+
+    unsigned long unchargedTicks;  ///< Instructions run in the current
+                                   ///< burst whose ticks were not charged
+                                   ///< yet.
+
     /// Private data structures.
-    int registers[NUM_TOTAL_REGS];  ///< CPU registers, for executing user
-                                    ///< programs.
+    int *registers;  ///< Registers of the CPU being simulated, for
+                     ///< executing user programs.
+
+    unsigned numCpus;
+    int *registerBanks;  ///< Registers of every CPU, one set after the
+                         ///< other.
 
     MMU mmu; ///< Memory management unit.
 
+    bool kernelAccess;  ///< An exception is being raised by `MapSpan`.
+
     ExceptionHandler handlers[NUM_EXCEPTION_TYPES];  ///< Exception handlers.
 };
 
@@ -34,15 +34,63 @@ Machine::Run()
         printf("Starting to run at time %lu\n", stats->totalTicks);
     }
     interrupt->SetStatus(USER_MODE);
+    stats->StartUserClock();
+
+    if (threadedDispatch) {
+        delete instr;
+        RunThreaded();  // Never returns.
+    }
 
     for (;;) {
         if (FetchInstruction(instr)) {
             ExecInstruction(instr);
         }
-        interrupt->OneTick();
-        if (singleStepper != nullptr && !singleStepper->Step()) {
-            singleStepper = nullptr;
-        }
+        Tick();
+    }
+}
+
+/// Advance simulated time by one user instruction.
+///
+/// Normally this calls `Interrupt::OneTick` after every instruction.  In
+/// burst mode, `OneTick` is only called for the instruction on which the
+/// next pending interrupt might come due: the instructions before it just
+/// count how many ticks they owe, and these are charged all at once at the
+/// end of the burst.  Interrupts are thus still delivered at exactly the
+/// same simulated tick.
+///
+/// A burst also ends when an instruction traps into the kernel (see
+/// `RaiseException`), since the kernel can read the clock and schedule new
+/// interrupts.
+bool
+Machine::Tick()
+{
+    if (burstLeft > 0) {
+        burstLeft--;
+        unchargedTicks++;
+        return false;
+    }
+
+    ChargeBurst();
+    bool fired = interrupt->OneTick();
+    if (singleStepper != nullptr && !singleStepper->Step()) {
+        singleStepper = nullptr;
+    }
+
+    if (burstMode && singleStepper == nullptr) {
+        // Number of instructions after which the clock is still short of
+        // the next deadline.
+        unsigned long ticks = interrupt->TicksUntilDue();
+        burstLeft = ticks > 0 ? (ticks - 1) / USER_TICK : 0;
+    }
+    return fired;
+}
+
+void
+Machine::ChargeBurst()
+{
+    if (unchargedTicks > 0) {
+        interrupt->ChargeUserTicks(unchargedTicks);
+        unchargedTicks = 0;
     }
 }
 
@@ -64,26 +112,41 @@ Machine::FetchInstruction(Instruction *instr)
 {
     ASSERT(instr != nullptr);
 
-    int raw;
-    if (!ReadMem(registers[PC_REG], 4, &raw)) {
+    const Instruction *decoded;
+    ExceptionType e = mmu.FetchInstruction(registers[PC_REG], &decoded);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, registers[PC_REG]);
         return false;  // Exception occurred.
     }
-    instr->value = raw;
-    instr->Decode();
+    *instr = *decoded;
 
+    if (profiler != nullptr) {
+        profiler->Count(registers[PC_REG], instr->opCode);
+    }
+    if (tracer != nullptr) {
+        tracer->RecordInstruction(registers[PC_REG]);
+    }
     if (debug.IsEnabled('m')) {
-        const struct OpString *str = &OP_STRINGS[instr->opCode];
-
-        ASSERT(instr->opCode <= MAX_OPCODE);
-        DEBUG('m', "At PC = 0x%X: ", registers[PC_REG]);
-        DEBUG_CONT('m', str->string, instr->RegFromType(str->args[0]),
-                        instr->RegFromType(str->args[1]),
-                        instr->RegFromType(str->args[2]));
-        DEBUG_CONT('m', "\n");
+        TraceInstruction(instr);
     }
     return true;
 }
 
+void
+Machine::TraceInstruction(const Instruction *instr) const
+{
+    ASSERT(instr != nullptr);
+    ASSERT(instr->opCode <= MAX_OPCODE);
+
+    const struct OpString *str = &OP_STRINGS[instr->opCode];
+
+    DEBUG('m', "At PC = 0x%X: ", registers[PC_REG]);
+    DEBUG_CONT('m', str->string, instr->RegFromType(str->args[0]),
+                    instr->RegFromType(str->args[1]),
+                    instr->RegFromType(str->args[2]));
+    DEBUG_CONT('m', "\n");
+}
+
 /// Simulate R2000 multiplication.
 ///
 /// The words at `*hiPtr` and `*loPtr` are overwritten with the double-length
@@ -0,0 +1,367 @@
+/// Threaded-code engine for simulating the execution of user programs.
+///
+/// `Machine::Run` goes through `FetchInstruction` and the big `switch` in
+/// `ExecInstruction` for every simulated instruction.  This engine instead
+/// runs straight-line sequences of predecoded instructions taken from the
+/// decode cache: the page of the first instruction is translated once, and
+/// then each instruction jumps directly to the code that simulates it, by
+/// means of a computed `goto` (a GCC extension).  A sequence ends when:
+/// * control is transferred elsewhere (a taken branch or jump, once its
+///   delay slot has run);
+/// * an instruction traps into the kernel (system calls and exceptions), or
+///   is simulated by `ExecInstruction` and thus might have;
+/// * an interrupt fires, since the kernel may then change the translation
+///   or switch to another thread;
+/// * the end of the frame is reached.
+///
+/// Simulated time still advances through `Machine::Tick` after every
+/// instruction, so this engine runs user programs cycle for cycle like the
+/// `switch` one, in burst mode or not.  Only the most frequent instructions
+/// have their own handler here; the rest are delegated to `ExecInstruction`,
+/// so that both engines share their semantics.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "instruction.hh"
+#include "machine.hh"
+#include "threads/system.hh"
+
+
+void
+Machine::RunThreaded()
+{
+    // Handler for each `opCode`.  Label addresses can only be taken inside
+    // the function that contains them, so the table is filled in here.
+    static void *opHandlers[MAX_OPCODE + 1];
+    if (opHandlers[0] == nullptr) {
+        for (unsigned i = 0; i <= MAX_OPCODE; i++) {
+            opHandlers[i] = &&slow;
+        }
+        opHandlers[OP_ADDIU] = &&op_addiu;
+        opHandlers[OP_ADDU]  = &&op_addu;
+        opHandlers[OP_AND]   = &&op_and;
+        opHandlers[OP_ANDI]  = &&op_andi;
+        opHandlers[OP_BEQ]   = &&op_beq;
+        opHandlers[OP_BGEZ]  = &&op_bgez;
+        opHandlers[OP_BGTZ]  = &&op_bgtz;
+        opHandlers[OP_BLEZ]  = &&op_blez;
+        opHandlers[OP_BLTZ]  = &&op_bltz;
+        opHandlers[OP_BNE]   = &&op_bne;
+        opHandlers[OP_J]     = &&op_j;
+        opHandlers[OP_JAL]   = &&op_jal;
+        opHandlers[OP_JALR]  = &&op_jalr;
+        opHandlers[OP_JR]    = &&op_jr;
+        opHandlers[OP_LB]    = &&op_lb;
+        opHandlers[OP_LBU]   = &&op_lb;
+        opHandlers[OP_LH]    = &&op_lh;
+        opHandlers[OP_LHU]   = &&op_lh;
+        opHandlers[OP_LW]    = &&op_lw;
+        opHandlers[OP_MFHI]  = &&op_mfhi;
+        opHandlers[OP_MFLO]  = &&op_mflo;
+        opHandlers[OP_MTHI]  = &&op_mthi;
+        opHandlers[OP_MTLO]  = &&op_mtlo;
+        opHandlers[OP_NOR]   = &&op_nor;
+        opHandlers[OP_OR]    = &&op_or;
+        opHandlers[OP_ORI]   = &&op_ori;
+        opHandlers[OP_SB]    = &&op_sb;
+        opHandlers[OP_SH]    = &&op_sh;
+        opHandlers[OP_SLL]   = &&op_sll;
+        opHandlers[OP_SLLV]  = &&op_sllv;
+        opHandlers[OP_SLT]   = &&op_slt;
+        opHandlers[OP_SLTI]  = &&op_slti;
+        opHandlers[OP_SLTIU] = &&op_sltiu;
+        opHandlers[OP_SLTU]  = &&op_sltu;
+        opHandlers[OP_SRA]   = &&op_sra;
+        opHandlers[OP_SRAV]  = &&op_srav;
+        opHandlers[OP_SUBU]  = &&op_subu;
+        opHandlers[OP_SW]    = &&op_sw;
+        opHandlers[OP_XOR]   = &&op_xor;
+        opHandlers[OP_XORI]  = &&op_xori;
+    }
+
+    for (;;) {
+        const Instruction *instr;
+        unsigned physAddr;
+        ExceptionType e = mmu.FetchInstruction(registers[PC_REG], &instr,
+                                               &physAddr);
+        if (e != NO_EXCEPTION) {
+            RaiseException(e, registers[PC_REG]);
+            Tick();
+            continue;
+        }
+
+        // Number of instructions left in the frame, this one included.
+        unsigned left = (pageSize - physAddr % pageSize) / 4;
+
+        for (;;) {
+            int pc = registers[PC_REG];
+            int pcAfter = registers[NEXT_PC_REG] + 4;
+            int nextLoadReg = 0;
+            int nextLoadValue = 0;
+            int tmp, value;
+            bool trapped = false;
+
+            if (profiler != nullptr) {
+                profiler->Count(pc, instr->opCode);
+            }
+            if (tracer != nullptr) {
+                tracer->RecordInstruction(pc);
+            }
+            if (debug.IsEnabled('m')) {
+                TraceInstruction(instr);
+            }
+            goto *opHandlers[instr->opCode];
+
+        op_addiu:
+            registers[instr->rt] = registers[instr->rs] + instr->extra;
+            goto commit;
+
+        op_addu:
+            registers[instr->rd] = registers[instr->rs]
+                                   + registers[instr->rt];
+            goto commit;
+
+        op_and:
+            registers[instr->rd] = registers[instr->rs]
+                                   & registers[instr->rt];
+            goto commit;
+
+        op_andi:
+            registers[instr->rt] = registers[instr->rs]
+                                   & (instr->extra & 0xFFFF);
+            goto commit;
+
+        op_beq:
+            if (registers[instr->rs] == registers[instr->rt]) {
+                pcAfter = registers[NEXT_PC_REG] + IndexToAddr(instr->extra);
+            }
+            goto commit;
+
+        op_bgez:
+            if (!(registers[instr->rs] & SIGN_BIT)) {
+                pcAfter = registers[NEXT_PC_REG] + IndexToAddr(instr->extra);
+            }
+            goto commit;
+
+        op_bgtz:
+            if (registers[instr->rs] > 0) {
+                pcAfter = registers[NEXT_PC_REG] + IndexToAddr(instr->extra);
+            }
+            goto commit;
+
+        op_blez:
+            if (registers[instr->rs] <= 0) {
+                pcAfter = registers[NEXT_PC_REG] + IndexToAddr(instr->extra);
+            }
+            goto commit;
+
+        op_bltz:
+            if (registers[instr->rs] & SIGN_BIT) {
+                pcAfter = registers[NEXT_PC_REG] + IndexToAddr(instr->extra);
+            }
+            goto commit;
+
+        op_bne:
+            if (registers[instr->rs] != registers[instr->rt]) {
+                pcAfter = registers[NEXT_PC_REG] + IndexToAddr(instr->extra);
+            }
+            goto commit;
+
+        op_jal:
+            registers[RET_ADDR_REG] = registers[NEXT_PC_REG] + 4;
+        op_j:
+            pcAfter = (pcAfter & 0xF0000000) | IndexToAddr(instr->extra);
+            goto commit;
+
+        op_jalr:
+            registers[instr->rd] = registers[NEXT_PC_REG] + 4;
+        op_jr:
+            pcAfter = registers[instr->rs];
+            goto commit;
+
+        op_lb:
+            tmp = registers[instr->rs] + instr->extra;
+            if (!ReadMem(tmp, 1, &value)) {
+                goto next;
+            }
+            if (value & 0x80 && instr->opCode == OP_LB) {
+                value |= 0xFFFFFF00;
+            } else {
+                value &= 0xFF;
+            }
+            nextLoadReg = instr->rt;
+            nextLoadValue = value;
+            goto commit;
+
+        op_lh:
+            tmp = registers[instr->rs] + instr->extra;
+            if (tmp & 0x1) {
+                RaiseException(ADDRESS_ERROR_EXCEPTION, tmp);
+                goto next;
+            }
+            if (!ReadMem(tmp, 2, &value)) {
+                goto next;
+            }
+            if (value & 0x8000 && instr->opCode == OP_LH) {
+                value |= 0xFFFF0000;
+            } else {
+                value &= 0xFFFF;
+            }
+            nextLoadReg = instr->rt;
+            nextLoadValue = value;
+            goto commit;
+
+        op_lw:
+            tmp = registers[instr->rs] + instr->extra;
+            if (tmp & 0x3) {
+                RaiseException(ADDRESS_ERROR_EXCEPTION, tmp);
+                goto next;
+            }
+            if (!ReadMem(tmp, 4, &value)) {
+                goto next;
+            }
+            nextLoadReg = instr->rt;
+            nextLoadValue = value;
+            goto commit;
+
+        op_mfhi:
+            registers[instr->rd] = registers[HI_REG];
+            goto commit;
+
+        op_mflo:
+            registers[instr->rd] = registers[LO_REG];
+            goto commit;
+
+        op_mthi:
+            registers[HI_REG] = registers[instr->rs];
+            goto commit;
+
+        op_mtlo:
+            registers[LO_REG] = registers[instr->rs];
+            goto commit;
+
+        op_nor:
+            registers[instr->rd] = ~(registers[instr->rs]
+                                     | registers[instr->rt]);
+            goto commit;
+
+        op_or:
+            registers[instr->rd] = registers[instr->rs]
+                                   | registers[instr->rt];
+            goto commit;
+
+        op_ori:
+            registers[instr->rt] = registers[instr->rs]
+                                   | (instr->extra & 0xFFFF);
+            goto commit;
+
+        op_sb:
+            if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra),
+                          1, registers[instr->rt])) {
+                goto next;
+            }
+            goto commit;
+
+        op_sh:
+            if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra),
+                          2, registers[instr->rt])) {
+                goto next;
+            }
+            goto commit;
+
+        op_sll:
+            registers[instr->rd] = registers[instr->rt] << instr->extra;
+            goto commit;
+
+        op_sllv:
+            registers[instr->rd] = registers[instr->rt]
+                                   << (registers[instr->rs] & 0x1F);
+            goto commit;
+
+        op_slt:
+            registers[instr->rd] =
+              (registers[instr->rs] < registers[instr->rt]) ? 1 : 0;
+            goto commit;
+
+        op_slti:
+            registers[instr->rt] =
+              (registers[instr->rs] < instr->extra) ? 1 : 0;
+            goto commit;
+
+        op_sltiu:
+            registers[instr->rt] = ((unsigned) registers[instr->rs]
+                                    < (unsigned) instr->extra) ? 1 : 0;
+            goto commit;
+
+        op_sltu:
+            registers[instr->rd] = ((unsigned) registers[instr->rs]
+                                    < (unsigned) registers[instr->rt]) ? 1 : 0;
+            goto commit;
+
+        op_sra:
+            registers[instr->rd] = registers[instr->rt] >> instr->extra;
+            goto commit;
+
+        op_srav:
+            registers[instr->rd] = registers[instr->rt]
+                                   >> (registers[instr->rs] & 0x1F);
+            goto commit;
+
+        op_subu:
+            registers[instr->rd] = registers[instr->rs]
+                                   - registers[instr->rt];
+            goto commit;
+
+        op_sw:
+            if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra),
+                          4, registers[instr->rt])) {
+                goto next;
+            }
+            goto commit;
+
+        op_xor:
+            registers[instr->rd] = registers[instr->rs]
+                                   ^ registers[instr->rt];
+            goto commit;
+
+        op_xori:
+            registers[instr->rt] = registers[instr->rs]
+                                   ^ (instr->extra & 0xFFFF);
+            goto commit;
+
+        slow:
+            // Everything else (traps, overflow checks, multiplication and
+            // division, unaligned accesses...) is left to the `switch`
+            // engine, which also advances the program counters.  It may
+            // have trapped into the kernel, even if the program counter
+            // moved on (as after a system call).
+            ExecInstruction(instr);
+            trapped = true;
+            goto next;
+
+        commit:
+            // Same as the end of `ExecInstruction`.
+            DelayedLoad(nextLoadReg, nextLoadValue);
+            registers[PREV_PC_REG] = registers[PC_REG];
+            registers[PC_REG] = registers[NEXT_PC_REG];
+            registers[NEXT_PC_REG] = pcAfter;
+
+        next:
+            bool fired = Tick();
+
+            // The rest of the sequence can only be used if execution simply
+            // went on to the next word, and nobody else had the chance to
+            // change the translation of the page.
+            if (fired || trapped || singleStepper != nullptr
+                  || registers[PC_REG] != pc + 4 || --left == 0) {
+                break;
+            }
+            physAddr += 4;
+            instr = mmu.FetchNext(physAddr);
+        }
+    }
+}
@@ -29,48 +29,298 @@
 
 
 #include "mmu.hh"
+#include "decode_cache.hh"
 #include "endianness.hh"
 #include "statistics.hh"
 #include "system.hh"
+#include "system_dep.hh"
+
+#include <limits.h>
 #include <stdio.h>
+#include <string.h>
+
+
+unsigned pageSize     = DEFAULT_PAGE_SIZE;
+unsigned numPhysPages = DEFAULT_NUM_PHYS_PAGES;
+unsigned memorySize   = DEFAULT_NUM_PHYS_PAGES * DEFAULT_PAGE_SIZE;
+
+/// Base 2 logarithm of `pageSize`, so that the fast paths can split an
+/// address with a shift and a mask instead of a division.  It is computed
+/// when the MMU is created.
+static unsigned pageShift;
+
+void
+SetMemoryLayout(unsigned frames, unsigned bytesPerPage)
+{
+    ASSERT(frames > 0);
+    ASSERT(bytesPerPage >= 4 && (bytesPerPage & (bytesPerPage - 1)) == 0);
+    ASSERT(frames <= UINT_MAX / bytesPerPage);
+
+    pageSize     = bytesPerPage;
+    numPhysPages = frames;
+    memorySize   = frames * bytesPerPage;
+}
+
+/// Virtual page number of an empty entry of the host translation cache.
+/// Virtual addresses are 32 bits wide, so no page gets this number.
+static const unsigned INVALID_VPN = UINT_MAX;
 
 
 MMU::MMU()
 {
-    mainMemory = new char [MEMORY_SIZE];
-    for (unsigned i = 0; i < MEMORY_SIZE; i++) {
-        mainMemory[i] = 0;
-    }
+    for (pageShift = 0; 1U << pageShift < pageSize; pageShift++) {}
+    ASSERT(1U << pageShift == pageSize);
+
+    mainMemory = new char [memorySize];
+    memset(mainMemory, 0, memorySize);
+    decodeCache = new DecodeCache(numPhysPages, pageSize);
+    FlushTranslations();
 
-#ifdef USE_TLB
-    tlb = new TranslationEntry[TLB_SIZE];
-    for (unsigned i = 0; i < TLB_SIZE; i++) {
-        tlb[i].valid = false;
-    }
-    pageTable = nullptr;
-#else  // Use linear page table.
     tlb = nullptr;
+    tlbStamps = nullptr;
+    tlbKept = nullptr;
+    currentASID = 0;
+    tlbSize = tlbWays = tlbSets = 0;
+    tlbPolicy = TLB_FIFO;
+    tlbClock = 0;
+    lastTLBIndex = 0;
+    fetchTLBIndex = 0;
     pageTable = nullptr;
+    pageTableSize = 0;
+    cpus = nullptr;
+    SetNumCpus(1);
+#ifdef USE_TLB
+    ConfigureTLB(TLB_SIZE, TLB_SIZE, TLB_FIFO);  // Fully associative.
 #endif
 }
 
 MMU::~MMU()
 {
     delete [] mainMemory;
-    if (tlb != nullptr) {
-        delete [] tlb;
+    delete decodeCache;
+    DeleteTLBs();
+    delete [] cpus;
+}
+
+void
+MMU::DeleteTLBs()
+{
+    for (unsigned i = 0; i < numCpus; i++) {
+        delete [] cpus[i].tlb;
+        delete [] cpus[i].tlbStamps;
+        delete [] cpus[i].tlbKept;
+        cpus[i].tlb = nullptr;
+        cpus[i].tlbStamps = nullptr;
+        cpus[i].tlbKept = nullptr;
+    }
+    tlb = nullptr;
+    tlbStamps = nullptr;
+    tlbKept = nullptr;
+}
+
+/// Only meant to be called at startup: the page table registers are
+/// cleared along with the TLBs.
+void
+MMU::SetNumCpus(unsigned count)
+{
+    ASSERT(count > 0);
+
+    if (cpus != nullptr) {
+        DeleteTLBs();
+        delete [] cpus;
+    }
+    numCpus = count;
+    currentCpu = 0;
+    cpus = new CpuState [numCpus];
+    for (unsigned i = 0; i < numCpus; i++) {
+        cpus[i].tlb = nullptr;
+        cpus[i].tlbStamps = nullptr;
+        cpus[i].tlbKept = nullptr;
+        cpus[i].currentASID = 0;
+        cpus[i].pageTable = nullptr;
+        cpus[i].pageTableSize = 0;
+    }
+    currentASID = 0;
+    pageTable = nullptr;
+    pageTableSize = 0;
+    if (tlbSize > 0) {
+        ConfigureTLB(tlbSize, tlbWays, tlbPolicy);
+    }
+}
+
+void
+MMU::SelectCpu(unsigned cpu)
+{
+    ASSERT(cpu < numCpus);
+
+    CpuState *old = &cpus[currentCpu];
+    old->currentASID   = currentASID;
+    old->pageTable     = pageTable;
+    old->pageTableSize = pageTableSize;
+
+    currentCpu = cpu;
+    CpuState *now = &cpus[cpu];
+    tlb           = now->tlb;
+    tlbStamps     = now->tlbStamps;
+    tlbKept       = now->tlbKept;
+    currentASID   = now->currentASID;
+    pageTable     = now->pageTable;
+    pageTableSize = now->pageTableSize;
+    FlushTranslations();
+}
+
+void
+MMU::ConfigureTLB(unsigned entries, unsigned ways, TLBPolicy policy)
+{
+    ASSERT(entries > 0);
+    ASSERT(ways > 0 && entries % ways == 0);
+    ASSERT(0 <= policy && policy < NUM_TLB_POLICIES);
+
+    DeleteTLBs();
+    tlbSize   = entries;
+    tlbWays   = ways;
+    tlbSets   = entries / ways;
+    tlbPolicy = policy;
+    for (unsigned i = 0; i < numCpus; i++) {
+        CpuState *cpu = &cpus[i];
+        cpu->tlb       = new TranslationEntry [tlbSize];
+        cpu->tlbStamps = new unsigned long [tlbSize];
+        cpu->tlbKept   = new bool [tlbSize];
+        for (unsigned j = 0; j < tlbSize; j++) {
+            cpu->tlb[j].valid = false;
+            cpu->tlbStamps[j] = 0;
+            cpu->tlbKept[j]   = false;
+        }
+    }
+    tlb       = cpus[currentCpu].tlb;
+    tlbStamps = cpus[currentCpu].tlbStamps;
+    tlbKept   = cpus[currentCpu].tlbKept;
+    tlbClock = 0;
+    FlushTranslations();
+    #ifdef USE_TLB
+    stats->InitTLBSets(tlbSets);
+    #endif
+}
+
+unsigned
+MMU::GetTLBSize() const
+{
+    return tlbSize;
+}
+
+TranslationEntry *
+MMU::PickTLBEntry(unsigned vpn)
+{
+    ASSERT(tlb != nullptr);
+
+    unsigned set   = vpn % tlbSets;
+    unsigned first = set * tlbWays;
+    unsigned victim = first;
+
+    for (unsigned i = first; i < first + tlbWays; i++) {
+        if (!tlb[i].valid) {
+            victim = i;
+            goto found;
+        }
+    }
+
+    switch (tlbPolicy) {
+        case TLB_FIFO:
+        case TLB_LRU:
+            // The stamp is the load time for FIFO, and the time of the last
+            // use for LRU.
+            for (unsigned i = first + 1; i < first + tlbWays; i++) {
+                if (tlbStamps[i] < tlbStamps[victim]) {
+                    victim = i;
+                }
+            }
+            break;
+
+        case TLB_RANDOM:
+            victim = first + SystemDep::Random() % tlbWays;
+            break;
+
+        default:
+            ASSERT(false);
     }
+    #ifdef USE_TLB
+    stats->tlbEvictions[set]++;
+    #endif
+
+found:
+    DEBUG('a', "TLB entry %u (set %u) chosen for virtual page %u\n",
+          victim, set, vpn);
+    tlbStamps[victim] = ++tlbClock;
+    tlbKept[victim] = false;
+    // The entry is about to be overwritten.
+    FlushTranslations();
+    return &tlb[victim];
+}
+
+void
+MMU::SetASID(unsigned asid)
+{
+    ASSERT(tlb != nullptr);
+
+    currentASID = asid;
+    for (unsigned i = 0; i < tlbSize; i++) {
+        tlbKept[i] = tlb[i].valid && tlb[i].asid == asid;
+    }
+    FlushTranslations();
+}
+
+unsigned
+MMU::GetASID() const
+{
+    return currentASID;
+}
+
+void
+MMU::FlushASID(unsigned asid)
+{
+    ASSERT(tlb != nullptr);
+
+    for (unsigned i = 0; i < numCpus; i++) {
+        TranslationEntry *entries = cpus[i].tlb;
+        for (unsigned j = 0; j < tlbSize; j++) {
+            if (entries[j].valid && entries[j].asid == asid) {
+                entries[j].valid = false;
+                cpus[i].tlbKept[j] = false;
+            }
+        }
+    }
+    FlushTranslations();
+}
+
+void
+MMU::FlushPage(unsigned asid, unsigned vpn)
+{
+    ASSERT(tlb != nullptr);
+
+    for (unsigned i = 0; i < numCpus; i++) {
+        TranslationEntry *entries = cpus[i].tlb;
+        for (unsigned j = 0; j < tlbSize; j++) {
+            if (entries[j].valid && entries[j].asid == asid
+                  && entries[j].virtualPage == vpn) {
+                entries[j].valid = false;
+                cpus[i].tlbKept[j] = false;
+            }
+        }
+    }
+    FlushTranslations();
 }
 
 void
 MMU::PrintTLB() const
 {
 #ifdef USE_TLB
-    printf("TLB content (%u entries):\n", TLB_SIZE);
-    for (unsigned i = 0; i < TLB_SIZE; i++) {
+    printf("TLB content (%u entries, %u sets of %u):\n",
+           tlbSize, tlbSets, tlbWays);
+    for (unsigned i = 0; i < tlbSize; i++) {
         const TranslationEntry *e = &tlb[i];
-        printf("(%u) valid: %d, virt: %d, frame: %d, flags: %s%s%s\n",
-               i, e->valid, e->virtualPage, e->physicalPage,
+        printf("(%u) valid: %d, asid: %u, virt: %d, frame: %d,"
+               " flags: %s%s%s\n",
+               i, e->valid, e->asid, e->virtualPage, e->physicalPage,
                (e->readOnly) ? "readonly " : "",
                (e->use)      ? "use " : "",
                (e->dirty)    ? "dirty" : "");
@@ -80,6 +330,26 @@ MMU::PrintTLB() const
 #endif
 }
 
+/// Read `size` (1, 2, or 4) bytes of simulated memory stored at `host`.
+static inline int
+ReadHost(const char *host, unsigned size)
+{
+    switch (size) {
+        case 1:
+            return *host;
+
+        case 2:
+            return ShortToHost(*(const unsigned short *) host);
+
+        case 4:
+            return WordToHost(*(const unsigned *) host);
+
+        default:
+            ASSERT(false);
+            return 0;
+    }
+}
+
 /// Read `size` (1, 2, or 4) bytes of virtual memory at `addr` into
 /// the location pointed to by `value`.
 ///
@@ -94,6 +364,12 @@ MMU::ReadMem(unsigned addr, unsigned size, int *value)
 {
     ASSERT(value != nullptr);
 
+    const char *host = HostAddress(addr, size, false);
+    if (host != nullptr) {  // Fast path, no need to translate.
+        *value = ReadHost(host, size);
+        return NO_EXCEPTION;
+    }
+
     DEBUG('a', "Reading VA 0x%X, size %u\n", addr, size);
 
     unsigned physicalAddress;
@@ -102,26 +378,7 @@ MMU::ReadMem(unsigned addr, unsigned size, int *value)
         return e;
     }
 
-    int data;
-    switch (size) {
-        case 1:
-            data = mainMemory[physicalAddress];
-            *value = data;
-            break;
-
-        case 2:
-            data = *(unsigned short *) &mainMemory[physicalAddress];
-            *value = ShortToHost(data);
-            break;
-
-        case 4:
-            data = *(unsigned *) &mainMemory[physicalAddress];
-            *value = WordToHost(data);
-            break;
-
-        default:
-            ASSERT(false);
-    }
+    *value = ReadHost(&mainMemory[physicalAddress], size);
 
     DEBUG('a', "\tValue read: %8.8X\n", *value);
     return NO_EXCEPTION;
@@ -139,49 +396,192 @@ MMU::ReadMem(unsigned addr, unsigned size, int *value)
 ExceptionType
 MMU::WriteMem(unsigned addr, unsigned size, int value)
 {
-    DEBUG('a', "Writing VA 0x%X, size %u, value 0x%X\n", addr, size, value);
-
-    unsigned physicalAddress;
-    ExceptionType e = Translate(addr, &physicalAddress, size, true);
-    if (e != NO_EXCEPTION) {
-        return e;
+    char *host = HostAddress(addr, size, true);
+    if (host == nullptr) {
+        DEBUG('a', "Writing VA 0x%X, size %u, value 0x%X\n",
+              addr, size, value);
+
+        unsigned physicalAddress;
+        ExceptionType e = Translate(addr, &physicalAddress, size, true);
+        if (e != NO_EXCEPTION) {
+            return e;
+        }
+        host = &mainMemory[physicalAddress];
     }
 
     switch (size) {
         case 1:
-            mainMemory[physicalAddress]
-              = (unsigned char) (value & 0xFF);
+            *host = (unsigned char) (value & 0xFF);
             break;
 
         case 2:
-            *(unsigned short *) &mainMemory[physicalAddress]
+            *(unsigned short *) host
               = ShortToMachine((unsigned short) (value & 0xFFFF));
             break;
 
         case 4:
-            *(unsigned *) &mainMemory[physicalAddress]
-              = WordToMachine((unsigned) value);
+            *(unsigned *) host = WordToMachine((unsigned) value);
             break;
 
         default:
             ASSERT(false);
     }
+    decodeCache->InvalidateWord(host - mainMemory);
 
     return NO_EXCEPTION;
 }
 
 ExceptionType
-MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
+MMU::MapSpan(unsigned addr, unsigned size, bool writing,
+             char **host, unsigned *length)
 {
-    ASSERT(entry != nullptr);
+    ASSERT(size > 0);
+    ASSERT(host != nullptr);
+    ASSERT(length != nullptr);
+
+    DEBUG('a', "Mapping VA 0x%X, size %u, %s\n",
+          addr, size, writing ? "writing" : "reading");
+
+    unsigned physicalAddress;
+    ExceptionType e = Translate(addr, &physicalAddress, 1, writing);
+    if (e != NO_EXCEPTION) {
+        return e;
+    }
+
+    unsigned inPage = pageSize - addr % pageSize;
+    *length = size < inPage ? size : inPage;
+    *host   = &mainMemory[physicalAddress];
+
+    if (writing) {
+        unsigned end = physicalAddress + *length;
+        for (unsigned a = physicalAddress & ~3U; a < end; a += 4) {
+            decodeCache->InvalidateWord(a);
+        }
+    }
+    return NO_EXCEPTION;
+}
+
+/// Fetch the instruction at virtual address `addr` into `*instr`.
+///
+/// Returns an exception code if the translation step failed.
+///
+/// * `addr` is the virtual address of the instruction, as held by the PC.
+/// * `instr` is where to store a pointer to the decoded instruction; it
+///   stays valid until the next store into its frame.
+/// * `physAddr` is where to store the physical address of the instruction,
+///   if not null.
+ExceptionType
+MMU::FetchInstruction(unsigned addr, const Instruction **instr,
+                      unsigned *physAddr)
+{
+    ASSERT(instr != nullptr);
+
+    unsigned physicalAddress;
+    const char *host = HostAddress(addr, 4, false);
+    if (host != nullptr) {
+        physicalAddress = host - mainMemory;
+        fetchTLBIndex = hostCache[(addr >> pageShift) % HOST_CACHE_SIZE]
+                          .tlbIndex;
+    } else {
+        DEBUG('a', "Fetching VA 0x%X\n", addr);
+
+        ExceptionType e = Translate(addr, &physicalAddress, 4, false);
+        if (e != NO_EXCEPTION) {
+            return e;
+        }
+        fetchTLBIndex = lastTLBIndex;
+    }
+
+    *instr = decodeCache->Fetch(mainMemory, physicalAddress);
+    if (physAddr != nullptr) {
+        *physAddr = physicalAddress;
+    }
+    return NO_EXCEPTION;
+}
+
+const Instruction *
+MMU::FetchNext(unsigned physAddr)
+{
+    #ifdef USE_TLB
+    // Account for the TLB lookup that `Translate` would have done; it is a
+    // hit, since the page was just translated.
+    CountTLBHit(fetchTLBIndex);
+    #endif
+
+    return decodeCache->Fetch(mainMemory, physAddr);
+}
+
+void
+MMU::InvalidateFrame(unsigned frame)
+{
+    ASSERT(frame < numPhysPages);
+    decodeCache->InvalidateFrame(frame);
+    FlushTranslations();
+}
+
+void
+MMU::FlushTranslations()
+{
+    for (unsigned i = 0; i < HOST_CACHE_SIZE; i++) {
+        hostCache[i].vpn = INVALID_VPN;
+    }
+}
+
+/// A hit means that `Translate` already succeeded for this page (and for a
+/// store, if `writing`) since the last flush, so that doing it again would
+/// only find the same frame and set use and dirty bits that are already
+/// set.  It would also be a TLB hit, so that is accounted for.
+inline char *
+MMU::HostAddress(unsigned virtAddr, unsigned size, bool writing)
+{
+    unsigned vpn = virtAddr >> pageShift;
+    const HostTranslation *h = &hostCache[vpn % HOST_CACHE_SIZE];
+
+    if (h->vpn != vpn || (virtAddr & (size - 1)) != 0
+          || (writing && !h->writable)) {
+        return nullptr;
+    }
+
+    #ifdef USE_TLB
+    CountTLBHit(h->tlbIndex);
+    #endif
+
+    return h->page + (virtAddr & (pageSize - 1));
+}
+
+void
+MMU::CountTLBHit(unsigned index)
+{
+    ASSERT(index < tlbSize);
 
     #ifdef USE_TLB
     stats->accessTable++;
+    stats->hits++;
+    stats->tlbHits[index / tlbWays]++;
     #endif
+    if (tlbKept[index]) {  // Would have been flushed without identifiers.
+        tlbKept[index] = false;
+        #ifdef USE_TLB
+        stats->tlbMissesAvoided++;
+        #endif
+    }
+    if (tlbPolicy == TLB_LRU) {
+        tlbStamps[index] = ++tlbClock;
+    }
+}
+
+ExceptionType
+MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry)
+{
+    ASSERT(entry != nullptr);
 
     if (tlb == nullptr) {
         // Use a page table; `vpn` is an index in the table.
 
+        #ifdef USE_TLB
+        stats->accessTable++;
+        #endif
+
         if (vpn >= pageTableSize) {
             DEBUG_CONT('a', "virtual page # %u too large for"
                             " page table size %u!\n",
@@ -198,20 +598,24 @@ MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
         return NO_EXCEPTION;
 
     } else {
-        // Use the TLB.
-        unsigned i;
-        for (i = 0; i < TLB_SIZE; i++) {
+        // Use the TLB.  Only the set of `vpn` needs to be searched.
+        unsigned set = vpn % tlbSets;
+        for (unsigned i = set * tlbWays; i < (set + 1) * tlbWays; i++) {
             TranslationEntry *e = &tlb[i];
-            if (e->valid && e->virtualPage == vpn) {
+            if (e->valid && e->virtualPage == vpn
+                  && e->asid == currentASID) {
                 *entry = e;  // FOUND!
-                #ifdef USE_TLB
-                stats->hits++;
-                #endif
+                lastTLBIndex = i;
+                CountTLBHit(i);
                 return NO_EXCEPTION;
             }
         }
 
         // Not found.
+        #ifdef USE_TLB
+        stats->accessTable++;
+        stats->tlbMisses[set]++;
+        #endif
         DEBUG_CONT('a', "no valid TLB entry found for this virtual page!\n");
         return PAGE_FAULT_EXCEPTION;  // Really, this is a TLB fault, the
                                       // page may be in memory, but not in
@@ -250,8 +654,8 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
 
     // Calculate the virtual page number, and offset within the page,
     // from the virtual address.
-    unsigned vpn    = (unsigned) virtAddr / PAGE_SIZE;
-    unsigned offset = (unsigned) virtAddr % PAGE_SIZE;
+    unsigned vpn    = (unsigned) virtAddr / pageSize;
+    unsigned offset = (unsigned) virtAddr % pageSize;
 
     TranslationEntry *entry;
     ExceptionType exception = RetrievePageEntry(vpn, &entry);
@@ -269,8 +673,8 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
 
     // If the `pageFrame` is too big, there is something really wrong!  An
     // invalid translation was loaded into the page table or TLB.
-    if (pageFrame >= NUM_PHYS_PAGES) {
-        DEBUG_CONT('a', "frame %u > %u!\n", pageFrame, NUM_PHYS_PAGES);
+    if (pageFrame >= numPhysPages) {
+        DEBUG_CONT('a', "frame %u > %u!\n", pageFrame, numPhysPages);
         return BUS_ERROR_EXCEPTION;
     }
 
@@ -280,8 +684,21 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
         entry->dirty = true;
     }
 
-    *physAddr = pageFrame * PAGE_SIZE + offset;
-    ASSERT(*physAddr >= 0 && *physAddr + size <= MEMORY_SIZE);
+    *physAddr = pageFrame * pageSize + offset;
+    ASSERT(*physAddr >= 0 && *physAddr + size <= memorySize);
     DEBUG_CONT('a', "physical address 0x%X\n", *physAddr);
+
+    // Remember the translation, unless accesses are being traced, since
+    // the fast path does not print anything.
+    if (!debug.IsEnabled('a')) {
+        HostTranslation *h = &hostCache[vpn % HOST_CACHE_SIZE];
+        if (h->vpn != vpn) {
+            h->vpn      = vpn;
+            h->page     = &mainMemory[pageFrame * pageSize];
+            h->writable = false;
+            h->tlbIndex = lastTLBIndex;
+        }
+        h->writable = h->writable || writing;
+    }
     return NO_EXCEPTION;
 }
@@ -14,19 +14,49 @@
 #include "translation_entry.hh"
 
 
+class DecodeCache;
+class Instruction;
+
 /// Definitions related to the size, and format of user memory.
 
-const unsigned PAGE_SIZE = SECTOR_SIZE;  ///< Set the page size equal to the
-                                         ///< disk sector size, for
-                                         ///< simplicity.
-const unsigned NUM_PHYS_PAGES = 256;
-const unsigned MEMORY_SIZE = NUM_PHYS_PAGES * PAGE_SIZE;
+const unsigned DEFAULT_PAGE_SIZE = SECTOR_SIZE;  ///< Set the page size
+                                                 ///< equal to the disk
+                                                 ///< sector size, for
+                                                 ///< simplicity.
+const unsigned DEFAULT_NUM_PHYS_PAGES = 256;
+
+/// Size of a page, number of frames of physical memory, and total size of
+/// physical memory, in bytes.
+///
+/// They can only be changed at startup, with `SetMemoryLayout`, before the
+/// MMU is created; afterwards they must be treated as constants.
+extern unsigned pageSize;
+extern unsigned numPhysPages;
+extern unsigned memorySize;
+
+/// Set the number of frames of physical memory, and the size of a page,
+/// which must be a power of two of at least 4 bytes.
+void SetMemoryLayout(unsigned frames, unsigned bytesPerPage);
 
-/// Number of entries in the TLB, if one is present.
+/// Default number of entries in the TLB, if one is present.
 ///
-/// If there is a TLB, it will be small compared to page tables.
+/// If there is a TLB, it will be small compared to page tables.  Its size
+/// and layout can be changed at startup (see `MMU::ConfigureTLB`).
 const unsigned TLB_SIZE = 4;
 
+/// Policies for choosing which entry of a TLB set gets replaced when a new
+/// translation is loaded into a full set.
+enum TLBPolicy {
+    TLB_FIFO,    ///< The entry that was loaded first.
+    TLB_LRU,     ///< The entry that was used least recently.
+    TLB_RANDOM,  ///< Any entry of the set.
+    NUM_TLB_POLICIES
+};
+
+/// Number of entries in the host translation cache of the MMU (see
+/// `MMU::FlushTranslations`).  Must be a power of two.
+const unsigned HOST_CACHE_SIZE = 64;
+
 
 /// This class simulates an MMU (memory management unit) that can use either
 /// page tables or a TLB.
@@ -45,6 +75,103 @@ public:
 
     ExceptionType WriteMem(unsigned addr, unsigned size, int value);
 
+    /// Find where up to `size` bytes of virtual memory starting at `addr`
+    /// are in `mainMemory`, so that the kernel can copy them at once.
+    ///
+    /// Only the page of `addr` is translated, as for a 1 byte access: on
+    /// success, `*host` points to the byte at `addr` and `*length` is how
+    /// many of the `size` bytes are in that page.  When `writing`, the
+    /// decoded instructions of the span are dropped, since the caller is
+    /// about to change it.
+    ExceptionType MapSpan(unsigned addr, unsigned size, bool writing,
+                          char **host, unsigned *length);
+
+    /// Fetch the instruction at virtual address `addr`, already decoded.
+    ///
+    /// Translation is done exactly as for a 4 byte `ReadMem`, but the word
+    /// is decoded only the first time it is fetched from its frame.
+    ///
+    /// If `physAddr` is not null, the physical address of the instruction
+    /// is stored there, so that the following instructions of the same
+    /// frame can be fetched with `FetchNext`.
+    ExceptionType FetchInstruction(unsigned addr, const Instruction **instr,
+                                   unsigned *physAddr = nullptr);
+
+    /// Fetch the decoded instruction at physical address `physAddr`,
+    /// without translating it.
+    ///
+    /// Only meant for the instruction that follows, in the same frame, one
+    /// obtained from `FetchInstruction`; the translation of the page is
+    /// assumed to be unchanged since then.
+    const Instruction *FetchNext(unsigned physAddr);
+
+    /// Tell the MMU that the kernel changed the contents of `frame` behind
+    /// its back (for instance, by loading a page into it), so that stale
+    /// decoded instructions are dropped.
+    void InvalidateFrame(unsigned frame);
+
+    /// Forget every translation remembered by the host translation cache.
+    ///
+    /// Besides going through the page table or TLB, the MMU remembers, for
+    /// the last few virtual pages that were accessed, where they are in
+    /// `mainMemory`, so that further loads and stores into them are done
+    /// directly.  These must be forgotten whenever the translation might
+    /// have changed: on a context switch, when a frame is reused, and every
+    /// time the kernel returns from an exception (it may have changed the
+    /// page table or the TLB, or cleared the use or dirty bits).
+    void FlushTranslations();
+
+    /// Change the layout of the TLB to `entries` entries, grouped in sets
+    /// of `ways` entries each, and invalidate all of it.
+    ///
+    /// `ways` must divide `entries`: 1 makes the TLB direct mapped, and
+    /// `entries` makes it fully associative.  A virtual page can only be
+    /// held by the set number `vpn % (entries / ways)`.
+    void ConfigureTLB(unsigned entries, unsigned ways, TLBPolicy policy);
+
+    /// Return the number of entries of the TLB.
+    unsigned GetTLBSize() const;
+
+    /// Choose the TLB entry into which the translation of virtual page `vpn`
+    /// should be loaded: a free entry of its set if there is one, or else
+    /// the one picked by the replacement policy.
+    ///
+    /// If the returned entry is valid, the kernel must save its use and
+    /// dirty bits before overwriting it.
+    TranslationEntry *PickTLBEntry(unsigned vpn);
+
+    /// Switch the TLB to the address space identified by `asid`.
+    ///
+    /// Entries of other address spaces are kept, but do not match until
+    /// their address space is switched back in.
+    void SetASID(unsigned asid);
+
+    /// Return the identifier of the address space the TLB is switched to.
+    unsigned GetASID() const;
+
+    /// Invalidate every TLB entry of the address space identified by
+    /// `asid`, for instance because it no longer exists.
+    ///
+    /// The TLBs of every CPU are flushed.
+    void FlushASID(unsigned asid);
+
+    /// Invalidate the TLB entries of virtual page `vpn` of the address
+    /// space identified by `asid`, for instance because the kernel moved
+    /// the page to another frame.
+    ///
+    /// The TLBs of every CPU are flushed.
+    void FlushPage(unsigned asid, unsigned vpn);
+
+    /// Give each of `count` simulated CPUs a TLB of its own, laid out as
+    /// the current one, and its own page table registers.
+    ///
+    /// Every TLB starts out empty, and CPU 0 is selected.
+    void SetNumCpus(unsigned count);
+
+    /// Make the TLB, address space identifier and page table of CPU `cpu`
+    /// the ones used for translating addresses.
+    void SelectCpu(unsigned cpu);
+
     void PrintTLB() const;
 
     /// Data structures -- all of these are accessible to Nachos kernel code.
@@ -84,9 +211,81 @@ public:
 
 private:
 
+    /// Decoded copies of the instructions stored in `mainMemory`.
+    DecodeCache *decodeCache;
+
+    /// A remembered translation, from a virtual page straight to its place
+    /// in `mainMemory`.
+    struct HostTranslation {
+        unsigned vpn;  ///< Virtual page number, or `INVALID_VPN`.
+        char *page;    ///< Start of the page in `mainMemory`.
+        bool writable; ///< Whether stores may skip `Translate`, i.e. the
+                       ///< page was already written through it, so that
+                       ///< its dirty bit is set.
+        unsigned tlbIndex;  ///< TLB entry holding the translation, if
+                            ///< there is a TLB.
+    };
+
+    /// Host translation cache, direct mapped by virtual page number.
+    HostTranslation hostCache[HOST_CACHE_SIZE];
+
+    /// Return where `size` bytes at `virtAddr` are in `mainMemory`, if the
+    /// host translation cache knows and the access is aligned, or null
+    /// otherwise.
+    char *HostAddress(unsigned virtAddr, unsigned size, bool writing);
+
+    /// TLB layout; see `ConfigureTLB`.
+    unsigned tlbSize;
+    unsigned tlbWays;
+    unsigned tlbSets;
+    TLBPolicy tlbPolicy;
+
+    /// For each TLB entry, when it was loaded (`TLB_FIFO`) or last used
+    /// (`TLB_LRU`), in number of TLB events.
+    unsigned long *tlbStamps;
+    unsigned long tlbClock;
+
+    /// Identifier of the current address space.
+    unsigned currentASID;
+
+    /// For each TLB entry, whether it belongs to the current address space
+    /// and was kept across the last switch to it, without being used since.
+    /// Its first use is a miss that the identifiers avoided.
+    bool *tlbKept;
+
+    /// TLB entry found by the last successful TLB lookup.
+    unsigned lastTLBIndex;
+
+    /// TLB entry used by the last `FetchInstruction`, so that `FetchNext`
+    /// can account for it.
+    unsigned fetchTLBIndex;
+
+    /// Translation state of each simulated CPU.
+    ///
+    /// The state of the CPU being simulated is the one in `tlb`,
+    /// `tlbStamps`, `tlbKept`, `currentASID`, `pageTable` and
+    /// `pageTableSize`; the last three are only saved here when another CPU
+    /// is selected.
+    struct CpuState {
+        TranslationEntry *tlb;
+        unsigned long *tlbStamps;
+        bool *tlbKept;
+        unsigned currentASID;
+        TranslationEntry *pageTable;
+        unsigned pageTableSize;
+    };
+    CpuState *cpus;
+    unsigned numCpus;
+    unsigned currentCpu;
+
+    /// De-allocate the TLB of every CPU.
+    void DeleteTLBs();
+
+    /// Account for a TLB hit on entry `index`.
+    void CountTLBHit(unsigned index);
+
     /// Retrieve a page entry either from a page table or the TLB.
-    ExceptionType RetrievePageEntry(unsigned vpn,
-                                    TranslationEntry **entry) const;
+    ExceptionType RetrievePageEntry(unsigned vpn, TranslationEntry **entry);
 
     /// Translate an address, and check for alignment.
     ///
@@ -0,0 +1,204 @@
+/// Routines to manage the queue of pending interrupts.
+///
+/// DO NOT CHANGE -- part of the machine emulation
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "pending_queue.hh"
+#include "lib/utility.hh"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/// Initial number of slots of the heap and the pool.  There are rarely more
+/// interrupts in flight than devices.
+static const unsigned INITIAL_CAPACITY = 16;
+
+/// Double the size of an array of `*capacity` pointers, of which `used` are
+/// in use.
+static PendingInterrupt **
+Grow(PendingInterrupt **array, unsigned used, unsigned *capacity)
+{
+    ASSERT(capacity != nullptr);
+
+    *capacity *= 2;
+    PendingInterrupt **bigger = new PendingInterrupt * [*capacity];
+    memcpy(bigger, array, used * sizeof *array);
+    delete [] array;
+    return bigger;
+}
+
+PendingQueue::PendingQueue()
+{
+    capacity     = INITIAL_CAPACITY;
+    heap         = new PendingInterrupt * [capacity];
+    size         = 0;
+    poolCapacity = INITIAL_CAPACITY;
+    pool         = new PendingInterrupt * [poolCapacity];
+    poolSize     = 0;
+    inserted     = 0;
+}
+
+PendingQueue::~PendingQueue()
+{
+    for (unsigned i = 0; i < size; i++) {
+        delete heap[i];
+    }
+    for (unsigned i = 0; i < poolSize; i++) {
+        delete pool[i];
+    }
+    delete [] heap;
+    delete [] pool;
+}
+
+bool
+PendingQueue::IsEmpty() const
+{
+    return size == 0;
+}
+
+PendingInterrupt *
+PendingQueue::Head() const
+{
+    return size > 0 ? heap[0] : nullptr;
+}
+
+/// Take a record from the pool (or allocate a new one if the pool is
+/// empty), fill it in, and add it to the heap.
+void
+PendingQueue::Insert(VoidFunctionPtr handler, void *arg,
+                     unsigned long when, IntType type)
+{
+    PendingInterrupt *pend;
+    if (poolSize > 0) {
+        pend = pool[--poolSize];
+        *pend = PendingInterrupt(handler, arg, when, type);
+    } else {
+        pend = new PendingInterrupt(handler, arg, when, type);
+    }
+    pend->order = inserted++;
+
+    if (size == capacity) {
+        heap = Grow(heap, size, &capacity);
+    }
+    heap[size] = pend;
+    SiftUp(size++);
+}
+
+PendingInterrupt *
+PendingQueue::Pop()
+{
+    if (size == 0) {
+        return nullptr;
+    }
+
+    PendingInterrupt *first = heap[0];
+    heap[0] = heap[--size];
+    if (size > 0) {
+        SiftDown(0);
+    }
+    return first;
+}
+
+void
+PendingQueue::Release(PendingInterrupt *pend)
+{
+    ASSERT(pend != nullptr);
+
+    if (poolSize == poolCapacity) {
+        pool = Grow(pool, poolSize, &poolCapacity);
+    }
+    pool[poolSize++] = pend;
+}
+
+/// Subtracting the same amount from every entry would keep the heap
+/// ordered, but clamping at zero does not: overdue entries all end up due
+/// at 0, where they are ordered by `order` instead, which a parent and its
+/// child may have the other way round.  So the heap is built again.
+void
+PendingQueue::Shift(unsigned long ticks)
+{
+    for (unsigned i = 0; i < size; i++) {
+        heap[i]->when = heap[i]->when > ticks ? heap[i]->when - ticks : 0;
+    }
+    for (unsigned i = size / 2; i > 0; i--) {
+        SiftDown(i - 1);
+    }
+}
+
+/// Return whether `a` must fire before `b`.
+static inline bool
+Before(const PendingInterrupt *a, const PendingInterrupt *b)
+{
+    return a->when < b->when || (a->when == b->when && a->order < b->order);
+}
+
+static int
+CompareOrder(const void *a, const void *b)
+{
+    const PendingInterrupt *x = *(PendingInterrupt * const *) a;
+    const PendingInterrupt *y = *(PendingInterrupt * const *) b;
+
+    return Before(x, y) ? -1 : Before(y, x) ? 1 : 0;
+}
+
+/// The heap is only partially ordered, so a sorted copy is walked instead.
+/// This is only meant for debugging, so the cost does not matter.
+void
+PendingQueue::Apply(void (*func)(PendingInterrupt *)) const
+{
+    ASSERT(func != nullptr);
+
+    if (size == 0) {
+        return;
+    }
+
+    PendingInterrupt **sorted = new PendingInterrupt * [size];
+    memcpy(sorted, heap, size * sizeof *heap);
+    qsort(sorted, size, sizeof *sorted, CompareOrder);
+    for (unsigned i = 0; i < size; i++) {
+        func(sorted[i]);
+    }
+    delete [] sorted;
+}
+
+void
+PendingQueue::SiftUp(unsigned i)
+{
+    PendingInterrupt *pend = heap[i];
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+        if (!Before(pend, heap[parent])) {
+            break;
+        }
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = pend;
+}
+
+void
+PendingQueue::SiftDown(unsigned i)
+{
+    PendingInterrupt *pend = heap[i];
+    for (;;) {
+        unsigned child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && Before(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!Before(heap[child], pend)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = pend;
+}
@@ -0,0 +1,93 @@
+/// Data structures to keep the interrupts scheduled to occur in the future.
+///
+/// Pending interrupts used to be kept in a sorted `List`, which costs a walk
+/// of the list and a heap allocation for every interrupt scheduled.  This
+/// queue is a binary min-heap instead, so scheduling an interrupt and taking
+/// the earliest one both take O(log n) time, and finding out when the next
+/// interrupt is due takes O(1).
+///
+/// Interrupts that are due at the same tick come out in the order they were
+/// scheduled.
+///
+/// The `PendingInterrupt` records are pooled: the ones returned with
+/// `Release` are reused by later calls to `Insert`, so that once the number
+/// of interrupts in flight stabilizes there is no more memory allocation.
+///
+/// DO NOT CHANGE -- part of the machine emulation
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_PENDINGQUEUE__HH
+#define NACHOS_MACHINE_PENDINGQUEUE__HH
+
+
+#include "interrupt.hh"
+
+
+class PendingQueue {
+public:
+
+    /// Initialize an empty queue.
+    PendingQueue();
+
+    /// De-allocate the queue, along with every pending interrupt and every
+    /// pooled record.
+    ~PendingQueue();
+
+    /// Return whether no interrupt is pending.
+    bool IsEmpty() const;
+
+    /// Return the earliest pending interrupt, without removing it, or null
+    /// if there is none.
+    PendingInterrupt *Head() const;
+
+    /// Add an interrupt, due at time `when`.
+    void Insert(VoidFunctionPtr handler, void *arg,
+                unsigned long when, IntType type);
+
+    /// Remove and return the earliest pending interrupt, or null if there
+    /// is none.
+    ///
+    /// The record must be given back with `Release` once it is no longer
+    /// needed.
+    PendingInterrupt *Pop();
+
+    /// Put a record obtained from `Pop` back into the pool.
+    void Release(PendingInterrupt *pend);
+
+    /// Move every pending interrupt `ticks` ticks earlier (to time 0 at
+    /// most).
+    ///
+    /// Used when the tick counter is restarted.
+    void Shift(unsigned long ticks);
+
+    /// Apply a function to every pending interrupt, in the order they are
+    /// due.
+    void Apply(void (*func)(PendingInterrupt *)) const;
+
+private:
+
+    /// Restore the heap property, moving the entry at `i` up or down.
+    void SiftUp(unsigned i);
+    void SiftDown(unsigned i);
+
+    /// Binary heap of pending interrupts, ordered by due time and then by
+    /// `order`.
+    PendingInterrupt **heap;
+    unsigned size;
+    unsigned capacity;
+
+    /// Released records, ready to be reused.
+    PendingInterrupt **pool;
+    unsigned poolSize;
+    unsigned poolCapacity;
+
+    /// Number of interrupts inserted so far, used to break ties.
+    unsigned long inserted;
+};
+
+
+#endif
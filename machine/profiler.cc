@@ -0,0 +1,279 @@
+/// Routines for profiling user programs.
+///
+/// DO NOT CHANGE -- part of the machine emulation
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "profiler.hh"
+#include "bin/coff.h"
+#include "bin/extern/syms.h"
+#include "lib/utility.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// Number of functions and instructions listed as the hottest.
+static const unsigned HOT_ENTRIES = 20;
+
+/// Initial number of instructions that have room for a count.
+static const unsigned INITIAL_CAPACITY = 1024;
+
+Profiler::Profiler(const char *report, const char *symbols)
+{
+    ASSERT(report != nullptr);
+
+    reportName = report;
+    symbolName = symbols;
+    capacity   = INITIAL_CAPACITY;
+    pcCounts   = new unsigned long [capacity];
+    memset(pcCounts, 0, capacity * sizeof *pcCounts);
+    memset(opCounts, 0, sizeof opCounts);
+}
+
+Profiler::~Profiler()
+{
+    delete [] pcCounts;
+}
+
+void
+Profiler::Grow(unsigned index)
+{
+    unsigned bigger = capacity;
+    while (bigger <= index) {
+        bigger *= 2;
+    }
+
+    unsigned long *counts = new unsigned long [bigger];
+    memcpy(counts, pcCounts, capacity * sizeof *counts);
+    memset(&counts[capacity], 0, (bigger - capacity) * sizeof *counts);
+    delete [] pcCounts;
+    pcCounts = counts;
+    capacity = bigger;
+}
+
+/// A function of the profiled program.
+struct Function {
+    unsigned address;
+    const char *name;
+    unsigned long count;
+};
+
+static int
+CompareAddress(const void *a, const void *b)
+{
+    unsigned x = ((const Function *) a)->address;
+    unsigned y = ((const Function *) b)->address;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/// Read the text symbols of the COFF file `name`, sorted by address.
+///
+/// Return the number of symbols, or 0 if there are none or the file cannot
+/// be read.  The names point into `*strings`, which the caller must delete.
+static unsigned
+LoadFunctions(const char *name, Function **functions, char **strings)
+{
+    ASSERT(functions != nullptr);
+    ASSERT(strings != nullptr);
+
+    *functions = nullptr;
+    *strings = nullptr;
+
+    FILE *f = fopen(name, "rb");
+    if (f == nullptr) {
+        return 0;
+    }
+
+    coffFileHeader fileHeader;
+    HDRR symbolHeader;
+    if (fread(&fileHeader, sizeof fileHeader, 1, f) != 1
+          || fileHeader.magic != COFF_MIPSELMAGIC
+          || fileHeader.symbolPtr == 0
+          || fseek(f, fileHeader.symbolPtr, SEEK_SET) != 0
+          || fread(&symbolHeader, sizeof symbolHeader, 1, f) != 1
+          || symbolHeader.iextMax <= 0 || symbolHeader.issExtMax <= 0) {
+        fclose(f);
+        return 0;
+    }
+
+    unsigned numExternals = symbolHeader.iextMax;
+    EXTR *externals = new EXTR [numExternals];
+    *strings = new char [symbolHeader.issExtMax + 1];
+    if (fseek(f, symbolHeader.cbExtOffset, SEEK_SET) != 0
+          || fread(externals, sizeof *externals, numExternals, f)
+               != numExternals
+          || fseek(f, symbolHeader.cbSsExtOffset, SEEK_SET) != 0
+          || fread(*strings, 1, symbolHeader.issExtMax, f)
+               != (size_t) symbolHeader.issExtMax) {
+        delete [] externals;
+        delete [] *strings;
+        *strings = nullptr;
+        fclose(f);
+        return 0;
+    }
+    (*strings)[symbolHeader.issExtMax] = '\0';
+    fclose(f);
+
+    *functions = new Function [numExternals];
+    unsigned count = 0;
+    for (unsigned i = 0; i < numExternals; i++) {
+        const SYMR *sym = &externals[i].asym;
+        if (sym->sc == scText && sym->iss >= 0
+              && sym->iss < symbolHeader.issExtMax) {
+            Function *fn = &(*functions)[count++];
+            fn->address = sym->value;
+            fn->name    = &(*strings)[sym->iss];
+            fn->count   = 0;
+        }
+    }
+    delete [] externals;
+
+    qsort(*functions, count, sizeof **functions, CompareAddress);
+    return count;
+}
+
+/// Return the function holding the instruction at `pc`: the last one that
+/// starts at or before it, or null if there is none.
+static Function *
+FindFunction(Function *functions, unsigned count, unsigned pc)
+{
+    unsigned low = 0, high = count;  // Look in [low, high).
+    while (low < high) {
+        unsigned middle = low + (high - low) / 2;
+        if (functions[middle].address <= pc) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low > 0 ? &functions[low - 1] : nullptr;
+}
+
+/// Print the name of an instruction, without its operands.
+static void
+PrintMnemonic(FILE *f, unsigned opCode)
+{
+    const char *s = OP_STRINGS[opCode].string;
+    fprintf(f, "%.*s", (int) strcspn(s, " "), s);
+}
+
+static double
+Percent(unsigned long part, unsigned long total)
+{
+    return total > 0 ? 100.0 * part / total : 0.0;
+}
+
+/// Choose the indexes of the (at most) `max` largest values out of `count`
+/// values, largest first.  Return how many were chosen.
+static unsigned
+Hottest(const unsigned long *values, unsigned count,
+        unsigned *chosen, unsigned max)
+{
+    unsigned n = 0;
+    for (unsigned i = 0; i < count; i++) {
+        if (values[i] == 0) {
+            continue;
+        }
+        // Insertion into the sorted list of chosen indexes.
+        unsigned j = n < max ? n++ : max;
+        while (j > 0 && values[chosen[j - 1]] < values[i]) {
+            if (j < max) {
+                chosen[j] = chosen[j - 1];
+            }
+            j--;
+        }
+        if (j < max) {
+            chosen[j] = i;
+        }
+    }
+    return n;
+}
+
+void
+Profiler::WriteReport() const
+{
+    FILE *f = fopen(reportName, "w");
+    if (f == nullptr) {
+        fprintf(stderr, "ERROR: profile report `%s` could not be opened.\n",
+                reportName);
+        return;
+    }
+
+    unsigned long total = 0;
+    for (unsigned i = 0; i <= MAX_OPCODE; i++) {
+        total += opCounts[i];
+    }
+    fprintf(f, "User program profile: %lu instructions run.\n", total);
+
+    unsigned chosen[MAX_OPCODE + 1];
+    unsigned n = Hottest(opCounts, MAX_OPCODE + 1, chosen, MAX_OPCODE + 1);
+    fprintf(f, "\nInstruction mix:\n%12s %7s  %s\n",
+            "count", "%", "instruction");
+    for (unsigned i = 0; i < n; i++) {
+        unsigned long count = opCounts[chosen[i]];
+        fprintf(f, "%12lu %6.2f%%  ", count, Percent(count, total));
+        PrintMnemonic(f, chosen[i]);
+        fprintf(f, "\n");
+    }
+
+    Function *functions = nullptr;
+    char *strings = nullptr;
+    unsigned numFunctions = 0;
+    if (symbolName != nullptr) {
+        numFunctions = LoadFunctions(symbolName, &functions, &strings);
+        if (numFunctions == 0) {
+            fprintf(f, "\nNo symbols could be read from `%s`.\n",
+                    symbolName);
+        }
+    }
+
+    if (numFunctions > 0) {
+        for (unsigned i = 0; i < capacity; i++) {
+            if (pcCounts[i] != 0) {
+                Function *fn = FindFunction(functions, numFunctions, i * 4);
+                if (fn != nullptr) {
+                    fn->count += pcCounts[i];
+                }
+            }
+        }
+        unsigned long *counts = new unsigned long [numFunctions];
+        for (unsigned i = 0; i < numFunctions; i++) {
+            counts[i] = functions[i].count;
+        }
+        unsigned hot[HOT_ENTRIES];
+        n = Hottest(counts, numFunctions, hot, HOT_ENTRIES);
+        fprintf(f, "\nHot functions:\n%12s %7s  %s\n",
+                "count", "%", "function");
+        for (unsigned i = 0; i < n; i++) {
+            const Function *fn = &functions[hot[i]];
+            fprintf(f, "%12lu %6.2f%%  %s\n",
+                    fn->count, Percent(fn->count, total), fn->name);
+        }
+        delete [] counts;
+    }
+
+    unsigned hot[HOT_ENTRIES];
+    n = Hottest(pcCounts, capacity, hot, HOT_ENTRIES);
+    fprintf(f, "\nHot instructions:\n%10s %12s %7s  %s\n",
+            "address", "count", "%", "location");
+    for (unsigned i = 0; i < n; i++) {
+        unsigned pc = hot[i] * 4;
+        unsigned long count = pcCounts[hot[i]];
+        fprintf(f, "0x%08X %12lu %6.2f%%  ", pc, count, Percent(count, total));
+        const Function *fn = FindFunction(functions, numFunctions, pc);
+        if (fn != nullptr) {
+            fprintf(f, "%s+0x%X", fn->name, pc - fn->address);
+        }
+        fprintf(f, "\n");
+    }
+
+    delete [] functions;
+    delete [] strings;
+    fclose(f);
+}
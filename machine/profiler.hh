@@ -0,0 +1,74 @@
+/// Instruction-level profiler for user programs.
+///
+/// While profiling, the machine simulation counts how many times the
+/// instruction at each program counter is run, and how many instructions of
+/// each kind (`opCode`) are run.  When Nachos halts, a report is written
+/// with the instruction mix and the hottest code.  If the COFF file of the
+/// program is given, the hot code is mapped back to the functions of the
+/// program, using the same external symbol table that `bin/disassemble`
+/// prints.  (User programs must then be linked without `-s`.)
+///
+/// Program counters are virtual addresses, so the counts of every address
+/// space are added together: profile one program at a time.
+///
+/// DO NOT CHANGE -- part of the machine emulation
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_PROFILER__HH
+#define NACHOS_MACHINE_PROFILER__HH
+
+
+#include "encoding.hh"
+
+
+class Profiler {
+public:
+
+    /// Start profiling, with every count at zero.
+    ///
+    /// * `reportName` is the file where the report is written.
+    /// * `symbolName` is the COFF file of the program being profiled, or
+    ///   null if the report should not name functions.
+    Profiler(const char *reportName, const char *symbolName);
+
+    ~Profiler();
+
+    /// Account for running the instruction at `pc`, of kind `opCode`.
+    ///
+    /// Called for every user instruction, so it has to be cheap.
+    void Count(unsigned pc, unsigned opCode)
+    {
+        unsigned index = pc / 4;
+        if (index >= capacity) {
+            Grow(index);
+        }
+        pcCounts[index]++;
+        opCounts[opCode]++;
+    }
+
+    /// Write the report.
+    void WriteReport() const;
+
+private:
+
+    /// Make room for the count of the instruction number `index`.
+    void Grow(unsigned index);
+
+    const char *reportName;
+    const char *symbolName;
+
+    /// Executions of each instruction, indexed by program counter divided
+    /// by 4.
+    unsigned long *pcCounts;
+    unsigned capacity;
+
+    /// Executions of each kind of instruction.
+    unsigned long opCounts[MAX_OPCODE + 1];
+};
+
+
+#endif
@@ -21,18 +21,80 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numCpus = 0;
+    cpuBusyTicks = nullptr;
+    numCpuSwitches = 0;
+    numDemotions = numPromotions = 0;
+    allocatedStacks = reusedStacks = 0;
     #ifdef DFS_TICKS_FIX
     tickResets = 0;
     #endif
     #ifdef USE_TLB
     accessTable = 0;
     hits = 0;
+    tlbSets = 0;
+    tlbHits = tlbMisses = tlbEvictions = nullptr;
+    tlbMissesAvoided = 0;
     #endif
     #ifdef SWAP
     toSwap = 0;
     fromSwap = 0;
     #endif
+    #ifdef SHARED_TEXT
+    loadedTextPages = sharedTextPages = 0;
+    #endif
+    #ifdef COPY_ON_WRITE
+    forkedPages = copiedPages = 0;
+    #endif
+    #ifdef EXEC_CACHE
+    cachedExecs = readExecs = 0;
+    #endif
+    #ifdef USER_PROGRAM
+    userClockStart = 0;
+    restoresAvoided = affinePicks = 0;
+    #endif
+}
+
+void
+Statistics::InitCpus(unsigned cpus)
+{
+    delete [] cpuBusyTicks;
+
+    numCpus      = cpus;
+    cpuBusyTicks = new unsigned long [cpus];
+    for (unsigned i = 0; i < cpus; i++) {
+        cpuBusyTicks[i] = 0;
+    }
+    numCpuSwitches = 0;
+}
+
+#ifdef USE_TLB
+void
+Statistics::InitTLBSets(unsigned sets)
+{
+    delete [] tlbHits;
+    delete [] tlbMisses;
+    delete [] tlbEvictions;
+
+    tlbSets      = sets;
+    tlbHits      = new unsigned long [sets];
+    tlbMisses    = new unsigned long [sets];
+    tlbEvictions = new unsigned long [sets];
+    for (unsigned i = 0; i < sets; i++) {
+        tlbHits[i] = tlbMisses[i] = tlbEvictions[i] = 0;
+    }
 }
+#endif
+
+#ifdef USER_PROGRAM
+void
+Statistics::StartUserClock()
+{
+    if (userClockStart == 0) {
+        userClockStart = SystemDep::HostTime();
+    }
+}
+#endif
 
 /// Print performance metrics, when we have finished everything at system
 /// shutdown.
@@ -53,10 +115,56 @@ Statistics::Print()
     printf("Paging: faults %lu\n", numPageFaults);
     printf("Network I/O: packets received %lu, sent %lu\n",
            numPacketsRecvd, numPacketsSent);
+    if (numCpus > 1) {
+        for (unsigned i = 0; i < numCpus; i++) {
+            printf("CPU %u: busy %lu ticks\n", i, cpuBusyTicks[i]);
+        }
+        printf("CPU switches: %lu\n", numCpuSwitches);
+    }
+    if (reusedStacks > 0) {
+        printf("Thread stacks: allocated %lu, reused %lu\n",
+               allocatedStacks, reusedStacks);
+    }
+    if (numDemotions + numPromotions > 0) {
+        printf("Feedback queues: demotions %lu, promotions %lu\n",
+               numDemotions, numPromotions);
+    }
     #ifdef USE_TLB
     printf("Hit Ratio: %lu\n", accessTable == 0 ? 0 : hits/accessTable);
+    for (unsigned i = 0; i < tlbSets; i++) {
+        printf("TLB set %u: hits %lu, misses %lu, evictions %lu\n",
+               i, tlbHits[i], tlbMisses[i], tlbEvictions[i]);
+    }
+    printf("TLB misses avoided after context switches: %lu\n",
+           tlbMissesAvoided);
     #endif
     #ifdef SWAP
     printf("Pages to SWAP: %lu, Pages from SWAP: %lu\n", toSwap, fromSwap);
     #endif
+    #ifdef SHARED_TEXT
+    printf("Code pages: loaded %lu, shared %lu\n",
+           loadedTextPages, sharedTextPages);
+    #endif
+    #ifdef COPY_ON_WRITE
+    printf("Forked pages: shared %lu, copied on write %lu\n",
+           forkedPages, copiedPages);
+    #endif
+    #ifdef EXEC_CACHE
+    printf("Executables: read %lu, from cache %lu\n",
+           readExecs, cachedExecs);
+    #endif
+    #ifdef USER_PROGRAM
+    if (restoresAvoided + affinePicks > 0) {
+        printf("Address space restores avoided: %lu, affine picks %lu\n",
+               restoresAvoided, affinePicks);
+    }
+    if (userClockStart != 0) {
+        // Host time includes the kernel and devices, not only the user
+        // instructions, so this is a lower bound of the engine's speed.
+        double seconds = SystemDep::HostTime() - userClockStart;
+        printf("Simulation speed: %lu user instructions in %.3f s, "
+               "%.2f MIPS\n", userTicks, seconds,
+               seconds > 0 ? userTicks / seconds / 1e6 : 0.0);
+    }
+    #endif
 }
@@ -19,7 +19,8 @@
 class Statistics {
 public:
 
-    /// Total time running Nachos.
+    /// Total time running Nachos.  With several CPUs, the latest time any
+    /// of them has reached (see `Interrupt::StartSlice`).
     unsigned long totalTicks;
 
     /// Time spent idle (no threads to run).
@@ -56,20 +57,99 @@ public:
     #ifdef USE_TLB
     unsigned long accessTable;
     unsigned long hits;
+
+    /// Number of sets of the TLB.
+    unsigned tlbSets;
+
+    /// TLB hits, misses and evictions of each set.
+    unsigned long *tlbHits;
+    unsigned long *tlbMisses;
+    unsigned long *tlbEvictions;
+
+    /// TLB hits on entries that were kept across a context switch thanks
+    /// to address space identifiers, and would otherwise have missed.
+    unsigned long tlbMissesAvoided;
     #endif
+    /// Number of simulated CPUs.
+    unsigned numCpus;
+
+    /// Ticks spent running threads, in the kernel or in user mode, by each
+    /// CPU.
+    unsigned long *cpuBusyTicks;
+
+    /// Number of times the simulation moved from one CPU to another.
+    unsigned long numCpuSwitches;
+
+    /// Times a thread was moved down a level of the feedback queues for
+    /// using up its quantum, and up for waiting too long.
+    unsigned long numDemotions;
+    unsigned long numPromotions;
+
+    /// Kernel thread stacks allocated, and taken from threads that had
+    /// finished instead.
+    unsigned long allocatedStacks;
+    unsigned long reusedStacks;
+
     #ifdef SWAP
     unsigned long toSwap;
     unsigned long fromSwap;
     #endif
 
+    #ifdef SHARED_TEXT
+    /// Code pages loaded from executables, and code pages mapped from the
+    /// text cache instead.
+    unsigned long loadedTextPages;
+    unsigned long sharedTextPages;
+    #endif
+
+    #ifdef COPY_ON_WRITE
+    /// Pages mapped by `Fork` into the child, and pages copied afterwards
+    /// because they were written to.
+    unsigned long forkedPages;
+    unsigned long copiedPages;
+    #endif
+
+    #ifdef EXEC_CACHE
+    /// Programs started by `Exec` from the executable cache, and from
+    /// their file.
+    unsigned long cachedExecs;
+    unsigned long readExecs;
+    #endif
+
 #ifdef DFS_TICKS_FIX
     /// Number of times the tick count gets reset.
     unsigned long tickResets;
 #endif
 
+#ifdef USER_PROGRAM
+    /// Host time at which the first user instruction was run, or zero if
+    /// no user program has run yet.
+    double userClockStart;
+
+    /// Context switches into a user thread whose address space was already
+    /// loaded in the MMU, so that restoring it (and flushing translations)
+    /// was skipped; and threads picked ahead of their turn because of that.
+    unsigned long restoresAvoided;
+    unsigned long affinePicks;
+#endif
+
     /// Initialize everything to zero.
     Statistics();
 
+    /// Set the number of simulated CPUs, and reset their statistics.
+    void InitCpus(unsigned cpus);
+
+#ifdef USE_TLB
+    /// Set the number of TLB sets, and reset their statistics.
+    void InitTLBSets(unsigned sets);
+#endif
+
+#ifdef USER_PROGRAM
+    /// Start measuring the host time spent simulating user programs, if not
+    /// started already.
+    void StartUserClock();
+#endif
+
     /// Print collected statistics.
     void Print();
 };
@@ -97,6 +177,8 @@ const unsigned long NETWORK_TIME  = 100;
   ///< Time to send or receive one packet.
 const unsigned long TIMER_TICKS   = 100;
   ///< (Average) time between timer interrupts.
+const unsigned long CPU_SLICE     = 100;
+  ///< Time each simulated CPU runs before the next one takes its turn.
 
 
 #endif
@@ -36,9 +36,7 @@ extern "C" {
 #include <sys/file.h>
 #include <sys/un.h>
 #include <sys/mman.h>
-#ifdef HOST_i386
 #include <sys/time.h>
-#endif
 #ifdef HOST_LINUX
 #include <sys/syscall.h>
 #include <unistd.h>
@@ -355,6 +353,14 @@ Random()
     return rand();
 }
 
+double
+HostTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
 /// Return an array, with the two pages just before and after the array
 /// unmapped, to catch illegal references off the end of the array.
 /// Particularly useful for catching overflow beyond fixed-size thread
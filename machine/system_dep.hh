@@ -75,6 +75,11 @@ namespace SystemDep {
 
     int Random();
 
+    /// Return the host's wall clock time, in seconds.
+    ///
+    /// Only useful for measuring how fast the simulation itself runs.
+    double HostTime();
+
     /// Allocate, de-allocate an array, such that de-referencing just beyond
     /// either end of the array will cause an error.
 
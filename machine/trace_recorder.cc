@@ -0,0 +1,130 @@
+/// Routines to record execution traces.
+///
+/// DO NOT CHANGE -- part of the machine emulation
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "trace_recorder.hh"
+#include "lib/utility.hh"
+#include "system_dep.hh"
+
+
+TraceRecorder::TraceRecorder(const char *fileName, bool delta)
+{
+    ASSERT(fileName != nullptr);
+
+    file         = SystemDep::OpenForWrite(fileName);
+    deltaMode    = delta;
+    nextPc       = 0;
+    lastData     = 0;
+    pendingSteps = 0;
+    used         = 0;
+
+    // The header is stored in little endian, like every field.
+    traceHeader h = { TRACE_MAGIC, TRACE_VERSION,
+                      (uint16_t) (delta ? TRACE_DELTA : 0) };
+    unsigned char header[sizeof h] = {
+        (unsigned char) h.magic, (unsigned char) (h.magic >> 8),
+        (unsigned char) (h.magic >> 16), (unsigned char) (h.magic >> 24),
+        (unsigned char) h.version, (unsigned char) (h.version >> 8),
+        (unsigned char) h.flags, (unsigned char) (h.flags >> 8)
+    };
+    for (unsigned i = 0; i < sizeof header; i++) {
+        PutByte(header[i]);
+    }
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    FlushSteps();
+    Flush();
+    SystemDep::Close(file);
+}
+
+void
+TraceRecorder::RecordAccess(bool write, unsigned addr, unsigned size)
+{
+    FlushSteps();
+
+    // Sizes take a byte, so block copies are split into several records.
+    do {
+        unsigned part = size < 255 ? size : 255;
+        PutByte(write ? TRACE_STORE : TRACE_LOAD);
+        PutByte(part);
+        PutAddress(addr, &lastData);
+        addr += part;
+        size -= part;
+    } while (size > 0);
+}
+
+void
+TraceRecorder::RecordException(unsigned type, unsigned badVAddr)
+{
+    FlushSteps();
+    PutByte(TRACE_EXCEPTION);
+    PutByte(type);
+    PutField(badVAddr);
+}
+
+void
+TraceRecorder::RecordSwitch(int pid, unsigned cpu)
+{
+    FlushSteps();
+    PutByte(TRACE_SWITCH);
+    PutField(pid + 1);
+    PutField(cpu);
+}
+
+void
+TraceRecorder::PutField(unsigned value)
+{
+    if (deltaMode) {
+        while (value >= 0x80) {
+            PutByte((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        PutByte(value);
+    } else {
+        PutByte(value);
+        PutByte(value >> 8);
+        PutByte(value >> 16);
+        PutByte(value >> 24);
+    }
+}
+
+void
+TraceRecorder::PutAddress(unsigned addr, unsigned *last)
+{
+    ASSERT(last != nullptr);
+
+    if (deltaMode) {
+        int difference = addr - *last;
+        PutField(((unsigned) difference << 1) ^ (unsigned) (difference >> 31));
+    } else {
+        PutField(addr);
+    }
+    *last = addr;
+}
+
+void
+TraceRecorder::FlushSteps()
+{
+    if (pendingSteps > 0) {
+        PutByte(TRACE_STEPS);
+        PutField(pendingSteps);
+        pendingSteps = 0;
+    }
+}
+
+void
+TraceRecorder::Flush()
+{
+    if (used > 0) {
+        SystemDep::WriteFile(file, (const char *) buffer, used);
+        used = 0;
+    }
+}
@@ -0,0 +1,98 @@
+/// Recorder of execution traces in binary form.
+///
+/// Tracing with `DEBUG('m', ...)` prints every instruction as text, which
+/// is too slow and too big for long runs.  This recorder instead writes a
+/// compact stream of records (see `bin/trace.h`) to a file, through a
+/// buffer, so that the cost of tracing is a few stores per event.  The
+/// trace can then be decoded, filtered and summarized by `bin/readtrace`.
+///
+/// DO NOT CHANGE -- part of the machine emulation
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_TRACERECORDER__HH
+#define NACHOS_MACHINE_TRACERECORDER__HH
+
+
+#include "bin/trace.h"
+
+
+class TraceRecorder {
+public:
+
+    /// Create the file `fileName` and write the header of the trace.
+    ///
+    /// If `delta` is true, fields are delta-encoded.
+    TraceRecorder(const char *fileName, bool delta);
+
+    /// Write whatever is still buffered and close the file.
+    ~TraceRecorder();
+
+    /// Record that the instruction at `pc` is being run.
+    void RecordInstruction(unsigned pc)
+    {
+        if (deltaMode) {
+            if (pc == nextPc) {
+                pendingSteps++;
+                nextPc += 4;
+                return;
+            }
+            FlushSteps();
+        }
+        PutByte(TRACE_PC);
+        PutAddress(pc, &nextPc);
+        nextPc = pc + 4;
+    }
+
+    /// Record a memory access of `size` bytes at `addr`.
+    ///
+    /// Accesses of more than 255 bytes are recorded as several.
+    void RecordAccess(bool write, unsigned addr, unsigned size);
+
+    /// Record that exception `type` was raised.
+    void RecordException(unsigned type, unsigned badVAddr);
+
+    /// Record that the thread of process `pid` (-1 for threads without one)
+    /// was given CPU `cpu`.
+    void RecordSwitch(int pid, unsigned cpu);
+
+private:
+
+    void PutByte(unsigned char b)
+    {
+        if (used == BUFFER_SIZE) {
+            Flush();
+        }
+        buffer[used++] = b;
+    }
+
+    /// Write a field, as a word or a variable-length integer.
+    void PutField(unsigned value);
+
+    /// Write an address, relative to `*last` in delta traces.
+    void PutAddress(unsigned addr, unsigned *last);
+
+    /// Write the count of sequential instructions not recorded yet.
+    void FlushSteps();
+
+    /// Write the buffer to the file.
+    void Flush();
+
+    static const unsigned BUFFER_SIZE = 64 * 1024;
+
+    int file;
+    bool deltaMode;
+
+    unsigned nextPc;         ///< Address following the last instruction.
+    unsigned lastData;       ///< Address of the last memory access.
+    unsigned pendingSteps;   ///< Sequential instructions not written yet.
+
+    unsigned char buffer[BUFFER_SIZE];
+    unsigned used;
+};
+
+
+#endif
@@ -54,6 +54,12 @@ public:
     /// This bit is set by the hardware every time the page is modified.
     bool dirty;
 
+    /// Address space identifier.  A TLB entry only translates addresses of
+    /// the address space whose identifier is loaded into the MMU (see
+    /// `MMU::SetASID`), so that entries of different address spaces can
+    /// share the TLB.  Ignored by linear page tables.
+    unsigned asid;
+
 };
 
 
@@ -14,7 +14,6 @@ Channel::~Channel() {
     delete lock;
     delete full;
     delete empty;
-    delete name;
 }
 
 const char *
@@ -10,9 +10,17 @@
 /// Usage
 /// =====
 ///
-///     nachos [-d <debugflags>] [-do <debugopts>] [-p]
+///     nachos [-d <debugflags>] [-do <debugopts>] [-p] [-smp <cpus>]
+///            [-mlfq <quantum>,<quantum>...] [-age <ticks>] [-fair]
+///            [-stk <words> <stacks>]
 ///            [-rs <random seed #>] [-z] [-tt]
-///            [-s] [-x <nachos file>] [-tc <consoleIn> <consoleOut>]
+///            [-s] [-th] [-bt] [-af <bound>] [-x <nachos file>]
+///            [-mp <physical pages>] [-ps <page size>]
+///            [-prof <report file>] [-profsym <coff file>]
+///            [-tr <trace file>] [-trd <trace file>]
+///            [-ckpt <checkpoint file> <tick>] [-resume <checkpoint file>]
+///            [-tlb <entries> <ways>] [-tlbp <policy>]
+///            [-tc <consoleIn> <consoleOut>]
 ///            [-f] [-cp <unix file> <nachos file>] [-pr <nachos file>]
 ///            [-rm <nachos file>] [-ls] [-D] [-c] [-tf]
 ///            [-n <network reliability>] [-id <machine id>]
@@ -26,6 +34,18 @@
 /// * `-do` -- enables options that modify the behavior when printing
 ///            debugging messages.
 /// * `-p`  -- enables preemptive multitasking for kernel threads.
+/// * `-smp` -- simulates a machine with several CPUs, which take turns to
+///            run in deterministic order.
+/// * `-mlfq` -- schedules threads with multilevel feedback queues, one per
+///            quantum given, in timer interrupts, from the top level down.
+///            Threads that use up their quantum move a level down.
+/// * `-age` -- sets the ticks a thread waits in a feedback queue before it
+///            moves a level up; 0 turns aging off.
+/// * `-fair` -- gives threads shares of the CPU in proportion to their
+///            priority plus one, instead of running the highest priority
+///            first.
+/// * `-stk` -- sets the size of the stacks of kernel threads, in words
+///            (4096 by default), and how many of them to allocate up front.
 /// * `-rs` -- causes `Yield` to occur at random (but repeatable) spots.
 /// * `-z`  -- prints version and copyright information, and exits.
 ///
@@ -39,7 +59,38 @@
 /// ----------------------
 ///
 /// * `-s`  -- causes user programs to be executed in single-step mode.
+/// * `-th` -- runs user programs with the threaded-code engine instead of
+///            the instruction `switch`.
+/// * `-bt` -- charges user instruction ticks in bursts that last until the
+///            next interrupt is due, instead of one at a time.
+/// * `-af` -- prefers to run threads of the address space loaded in the
+///            MMU, to avoid switching address spaces; the thread whose turn
+///            it is is passed over at most the given number of times.
 /// * `-x`  -- runs a user program.
+/// * `-mp` -- sets the number of physical pages of the simulated machine
+///            (256 by default).
+/// * `-ps` -- sets the size of a page in bytes, which must be a power of
+///            two (the disk sector size by default).
+/// * `-prof` -- counts the user instructions run at each address and of
+///            each kind, and writes the hottest ones to a report file when
+///            Nachos halts.
+/// * `-profsym` -- names the functions in the profile report, reading the
+///            symbols of the given COFF file (as linked, before
+///            `coff2noff`).
+/// * `-tr` -- records a binary trace of the user instructions run, the
+///            memory accessed, the exceptions raised and the thread
+///            switches, to be read with `bin/readtrace`.
+/// * `-trd` -- like `-tr`, but delta-encodes the trace to make it smaller.
+/// * `-ckpt` -- writes a checkpoint of the running user program to a file
+///            when the clock reaches the given tick (see
+///            `userprog/checkpoint.hh`).  Only one process may be running.
+/// * `-resume` -- resumes the user program saved in a checkpoint, instead
+///            of starting one with `-x`.
+/// * `-tlb` -- sets the number of TLB entries, and how many of them make up
+///            a set (1 for a direct-mapped TLB, as many as entries for a
+///            fully associative one).  Needs *USE_TLB*.
+/// * `-tlbp` -- sets the policy for replacing TLB entries: `fifo` (the
+///            default), `lru` or `random`.  Needs *USE_TLB*.
 /// * `-tc` -- tests the console.
 ///
 /// *FILESYS* options
@@ -92,6 +143,7 @@ void Copy(const char *unixFile, const char *nachosFile);
 void Print(const char *file);
 void PerformanceTest(void);
 void StartProcess(const char *file);
+void ResumeProcess(const char *file);
 void ConsoleTest(const char *in, const char *out);
 void MailTest(int networkID);
 
@@ -143,6 +195,10 @@ main(int argc, char **argv)
             ASSERT(argc > 1);
             StartProcess(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-resume")) {  // Resume a checkpoint.
+            ASSERT(argc > 1);
+            ResumeProcess(*(argv + 1));
+            argCount = 2;
         } else if (!strcmp(*argv, "-tc")) {  // Test the console.
             if (argc == 1) {
                 ConsoleTest(nullptr, nullptr);
@@ -9,8 +9,35 @@
 /// needed to wait for a lock, and the lock was busy, we would end up calling
 /// `FindNextToRun`, and that would put us in an infinite loop.
 ///
-/// Very simple implementation -- no priorities, straight FIFO.  Might need
-/// to be improved in later assignments.
+/// Threads run in order of priority, and in FIFO order within a priority.
+/// The queues of a priority are doubly linked through `Thread::readyNext`
+/// and `Thread::readyPrev`, so that a thread can be taken out of the middle
+/// of one; the highest priority with ready threads is the highest bit set
+/// in `ReadyQueues::nonEmpty`, found with a single instruction.
+///
+/// With feedback queues, the timer interrupt handler calls `TimerTick`,
+/// which charges the tick to the running thread and ages the ready ones.
+/// Only the head of each queue needs to be looked at for aging, since it
+/// has waited the longest.
+///
+/// With the fair-share policy, the ready threads of each CPU are kept
+/// instead in a binary heap ordered by virtual runtime, so that picking the
+/// next thread and queueing one take logarithmic time.  Work is charged to
+/// a thread each time it leaves the CPU, from the user and system ticks
+/// counted by `Statistics`.  A thread that becomes ready after a long wait,
+/// or for the first time, starts from the least virtual runtime the CPU has
+/// picked, so that it cannot keep the CPU for as long as it waited.
+///
+/// Switching to a user thread whose address space is the one loaded in the
+/// MMU, such as the one that was running before a kernel thread or an idle
+/// spell, does not restore it.  With address space affinity, threads of
+/// that address space are also preferred over the head of their queue.
+///
+/// With several CPUs, new threads are spread among them in turn, and a
+/// thread that becomes ready again goes back to the CPU it ran on last.  A
+/// CPU with nothing ready takes threads from the others.  The simulation
+/// still runs on a single host thread, one CPU after another, so that
+/// disabling interrupts keeps providing mutual exclusion.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -24,18 +51,259 @@
 #include <stdio.h>
 
 
+static_assert(NUM_COLAS <= 64, "A priority needs a bit of a 64-bit mask.");
+
+
 /// Initialize the list of ready but not running threads to empty.
-Scheduler::Scheduler()
+Scheduler::Scheduler(unsigned cpus)
 {
-    for (int i = 0; i < NUM_COLAS; i++)
-      queues[i] = new List<Thread *>;
+    ASSERT(cpus > 0);
+
+    numCpus = cpus;
+    queues = new ReadyQueues [numCpus];
+    for (unsigned c = 0; c < numCpus; c++) {
+        for (unsigned i = 0; i < NUM_COLAS; i++) {
+            queues[c].head[i] = queues[c].tail[i] = nullptr;
+        }
+        queues[c].nonEmpty = 0;
+        queues[c].heap = nullptr;
+        queues[c].heapSize = queues[c].heapCapacity = 0;
+        queues[c].minVruntime = 0;
+    }
+    running = new Thread * [numCpus];
+    for (unsigned i = 0; i < numCpus; i++)
+      running[i] = nullptr;
+    currentCpu = 0;
+    nextCpu = 0;
+    restoreOnResume = false;
+    sliceWork = 0;
+    levels = 0;
+    ageTicks = 0;
+    fairShare = false;
+    queued = 0;
+#ifdef USER_PROGRAM
+    affinityBound = 0;
+#endif
 }
 
 /// De-allocate the list of ready threads.
 Scheduler::~Scheduler()
 {
-    for (int i = 0; i < NUM_COLAS; i++)
-      delete queues[i];
+    for (unsigned c = 0; c < numCpus; c++) {
+        delete [] queues[c].heap;
+    }
+    delete [] queues;
+    delete [] running;
+}
+
+void
+Scheduler::Enqueue(unsigned cpu, Thread *thread, int priority)
+{
+    ASSERT(cpu < numCpus);
+    ASSERT(0 <= priority && priority < NUM_COLAS);
+
+    ReadyQueues *q = &queues[cpu];
+    thread->readySince = stats->userTicks + stats->systemTicks;
+#ifdef USER_PROGRAM
+    thread->passedOver = 0;
+#endif
+    thread->readyNext = nullptr;
+    thread->readyPrev = q->tail[priority];
+    if (q->tail[priority] != nullptr) {
+        q->tail[priority]->readyNext = thread;
+    } else {
+        q->head[priority] = thread;
+        q->nonEmpty |= (uint64_t) 1 << priority;
+    }
+    q->tail[priority] = thread;
+}
+
+void
+Scheduler::Unlink(unsigned cpu, Thread *thread, int priority)
+{
+    ASSERT(cpu < numCpus);
+    ASSERT(0 <= priority && priority < NUM_COLAS);
+
+    ReadyQueues *q = &queues[cpu];
+    if (thread->readyPrev != nullptr) {
+        thread->readyPrev->readyNext = thread->readyNext;
+    } else {
+        ASSERT(q->head[priority] == thread);
+        q->head[priority] = thread->readyNext;
+    }
+    if (thread->readyNext != nullptr) {
+        thread->readyNext->readyPrev = thread->readyPrev;
+    } else {
+        q->tail[priority] = thread->readyPrev;
+    }
+    if (q->head[priority] == nullptr) {
+        q->nonEmpty &= ~((uint64_t) 1 << priority);
+    }
+    thread->readyNext = thread->readyPrev = nullptr;
+}
+
+bool
+Scheduler::HasReady(unsigned cpu) const
+{
+    ASSERT(cpu < numCpus);
+    return queues[cpu].nonEmpty != 0 || queues[cpu].heapSize > 0;
+}
+
+/// Whether `a` runs before `b`: it has less virtual runtime, or the same
+/// and was queued earlier.
+bool
+Scheduler::RunsBefore(const Thread *a, const Thread *b)
+{
+    return a->vruntime < b->vruntime
+             || (a->vruntime == b->vruntime && a->readyOrder < b->readyOrder);
+}
+
+void
+Scheduler::HeapPush(unsigned cpu, Thread *thread)
+{
+    ASSERT(cpu < numCpus);
+
+    ReadyQueues *q = &queues[cpu];
+    if (q->heapSize == q->heapCapacity) {
+        unsigned capacity = q->heapCapacity == 0 ? 16 : 2 * q->heapCapacity;
+        Thread **heap = new Thread * [capacity];
+        for (unsigned i = 0; i < q->heapSize; i++) {
+            heap[i] = q->heap[i];
+        }
+        delete [] q->heap;
+        q->heap = heap;
+        q->heapCapacity = capacity;
+    }
+
+    if (thread->vruntime < q->minVruntime) {
+        thread->vruntime = q->minVruntime;
+    }
+    thread->readyOrder = queued++;
+
+    // Sift up.
+    unsigned i = q->heapSize++;
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+        Thread *p = q->heap[parent];
+        if (!RunsBefore(thread, p)) {
+            break;
+        }
+        q->heap[i] = p;
+        i = parent;
+    }
+    q->heap[i] = thread;
+}
+
+Thread *
+Scheduler::HeapPop(unsigned cpu)
+{
+    ASSERT(cpu < numCpus);
+
+    ReadyQueues *q = &queues[cpu];
+    ASSERT(q->heapSize > 0);
+
+    Thread *first = q->heap[0];
+    Thread *last = q->heap[--q->heapSize];
+
+    // Sift down.
+    unsigned i = 0;
+    for (;;) {
+        unsigned child = 2 * i + 1;
+        if (child >= q->heapSize) {
+            break;
+        }
+        Thread *c = q->heap[child];
+        if (child + 1 < q->heapSize) {
+            Thread *d = q->heap[child + 1];
+            if (RunsBefore(d, c)) {
+                child++;
+                c = d;
+            }
+        }
+        if (!RunsBefore(c, last)) {
+            break;
+        }
+        q->heap[i] = c;
+        i = child;
+    }
+    q->heap[i] = last;
+
+    if (first->vruntime > q->minVruntime) {
+        q->minVruntime = first->vruntime;
+    }
+    return first;
+}
+
+Thread *
+Scheduler::Pop(unsigned cpu)
+{
+    ASSERT(cpu < numCpus);
+
+    if (fairShare) {
+        return queues[cpu].heapSize > 0 ? HeapPop(cpu) : nullptr;
+    }
+    uint64_t nonEmpty = queues[cpu].nonEmpty;
+    if (nonEmpty == 0) {
+        return nullptr;
+    }
+    int priority = 63 - __builtin_clzll(nonEmpty);
+    Thread *thread = queues[cpu].head[priority];
+#ifdef USER_PROGRAM
+    if (affinityBound > 0 && cpu == currentCpu) {
+        thread = PickAffine(thread);
+    }
+#endif
+    Unlink(cpu, thread, priority);
+    return thread;
+}
+
+#ifdef USER_PROGRAM
+Thread *
+Scheduler::PickAffine(Thread *head)
+{
+    ASSERT(head != nullptr);
+
+    if (machine == nullptr || head->passedOver >= affinityBound
+          || (head->space != nullptr && head->space->IsLoaded())) {
+        return head;
+    }
+    Thread *t = head->readyNext;
+    for (unsigned i = 1; i < AFFINITY_SCAN && t != nullptr; i++) {
+        if (t->space != nullptr && t->space->IsLoaded()) {
+            DEBUG('t', "Running thread \"%s\" ahead of \"%s\" to keep its "
+                  "address space\n", t->GetName(), head->GetName());
+            head->passedOver++;
+            stats->affinePicks++;
+            return t;
+        }
+        t = t->readyNext;
+    }
+    return head;
+}
+
+void
+Scheduler::SetAffinity(unsigned bound)
+{
+    affinityBound = bound;
+}
+#endif
+
+void
+Scheduler::Charge(Thread *thread)
+{
+    ASSERT(thread != nullptr);
+
+    unsigned long work = stats->userTicks + stats->systemTicks;
+    unsigned long ticks = work - thread->runStart;
+    thread->runStart = work;
+    thread->cpuTicks += ticks;
+    thread->vruntime += ticks * NUM_COLAS / (thread->GetPriority() + 1);
+}
+
+unsigned
+Scheduler::GetCurrentCpu() const
+{
+    return currentCpu;
 }
 
 /// Mark a thread as ready, but not running.
@@ -49,23 +317,43 @@ Scheduler::ReadyToRun(Thread *thread)
 
     DEBUG('t', "Putting thread %s on ready list\n", thread->GetName());
 
+    if (thread->GetStatus() == JUST_CREATED) {
+        thread->SetCpu(nextCpu);
+        nextCpu = (nextCpu + 1) % numCpus;
+        if (levels > 0) {
+            thread->priority = levels - 1;
+        }
+    }
+    if (thread == currentThread) {  // Yielding: its key must be up to date.
+        Charge(thread);
+    }
     thread->SetStatus(READY);
 
-    queues[thread->GetPriority()]->Append(thread);
+    if (fairShare) {
+        HeapPush(thread->GetCpu(), thread);
+    } else {
+        Enqueue(thread->GetCpu(), thread, thread->GetPriority());
+    }
 }
 
 /// Return the next thread to be scheduled onto the CPU.
 ///
 /// If there are no ready threads, return null.
 ///
+/// The current CPU looks at its own ready list.  Only if it would be left
+/// idle otherwise, because the current thread is not running anymore, does
+/// it look at the ones of the other CPUs, in order.
+///
 /// Side effect: thread is removed from the ready list.
 Thread *
 Scheduler::FindNextToRun()
 {
-    for (int i = NUM_COLAS - 1; i >= 0; i--) {
-      if (!queues[i]->IsEmpty()) {
-        return queues[i]->Pop();
-      }
+    unsigned cpus = currentThread->GetStatus() == RUNNING ? 1 : numCpus;
+    for (unsigned c = 0; c < cpus; c++) {
+        Thread *thread = Pop((currentCpu + c) % numCpus);
+        if (thread != nullptr) {
+            return thread;
+        }
     }
     return nullptr;
 }
@@ -86,8 +374,6 @@ Scheduler::Run(Thread *nextThread)
 {
     ASSERT(nextThread != nullptr);
 
-    Thread *oldThread = currentThread;
-
 #ifdef USER_PROGRAM  // Ignore until running user programs.
     if (currentThread->space != nullptr) {
         // If this thread is a user program, save the user's CPU registers.
@@ -95,18 +381,34 @@ Scheduler::Run(Thread *nextThread)
         currentThread->space->SaveState();
     }
 #endif
-#ifdef USE_TLB
-    
-#endif
+
+    Dispatch(nextThread, true);
+}
+
+/// The second half of `Run`, which `SwitchCpu` shares: the thread it
+/// resumes may have been left running on its CPU, with its registers and
+/// address space still in place.
+void
+Scheduler::Dispatch(Thread *nextThread, bool restore)
+{
+    Thread *oldThread = currentThread;
 
     oldThread->CheckOverflow();  // Check if the old thread had an undetected
                                  // stack overflow.
 
+    Charge(oldThread);
+    nextThread->runStart = stats->userTicks + stats->systemTicks;
+
     currentThread = nextThread;  // Switch to the next thread.
     currentThread->SetStatus(RUNNING);  // `nextThread` is now running.
+    currentThread->SetCpu(currentCpu);
+    restoreOnResume = restore;
 
     DEBUG('t', "Switching from thread \"%s\" to thread \"%s\"\n",
           oldThread->GetName(), nextThread->GetName());
+#ifdef USER_PROGRAM
+    machine->TraceSwitch(nextThread->Pid, currentCpu);
+#endif
 
     // This is a machine-dependent assembly language routine defined in
     // `switch.s`.  You may have to think a bit to figure out what happens
@@ -118,51 +420,267 @@ Scheduler::Run(Thread *nextThread)
     DEBUG('t', "Now in thread \"%s\"\n", currentThread->GetName());
 
     // If the old thread gave up the processor because it was finishing, we
-    // need to delete its carcass.  Note we cannot delete the thread before
-    // now (for example, in `Thread::Finish`), because up to this point, we
-    // were still running on the old thread's stack!
+    // need to delete its carcass (unless it is still to be joined).  Note we
+    // cannot delete the thread before now (for example, in
+    // `Thread::Finish`), because up to this point, we were still running on
+    // the old thread's stack!
     if (threadToBeDestroyed != nullptr) {
-        delete threadToBeDestroyed;
+        threadToBeDestroyed->Drop();
         threadToBeDestroyed = nullptr;
     }
 
 #ifdef USER_PROGRAM
-    if (currentThread->space != nullptr) {
-        // If there is an address space to restore, do it.
+    if (restoreOnResume && currentThread->space != nullptr) {
+        // If there is an address space to restore, do it, unless the MMU
+        // still holds it.
         currentThread->RestoreUserState();
-        currentThread->space->RestoreState();
+        if (currentThread->space->IsLoaded()) {
+            stats->restoresAvoided++;
+        } else {
+            currentThread->space->RestoreState();
+        }
     }
 #endif
 }
 
-/// Print the scheduler state -- in other words, the contents of the ready
-/// list.
+/// CPUs take turns in round-robin order; a new round of slices starts each
+/// time the turn goes back past the last CPU.  A CPU only gets a turn if it
+/// has a running thread, or threads ready to run.
 ///
-/// For debugging.
-static void
-ThreadPrint(Thread *t)
+/// If the current thread is still running, it stays on its CPU, with its
+/// registers, until the turn comes back to it; otherwise the CPU is left
+/// idle.
+bool
+Scheduler::SwitchCpu()
 {
-    ASSERT(t != nullptr);
-    t->Print();
+    if (numCpus == 1) {
+        return false;
+    }
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+
+    Thread *oldThread = currentThread;
+    bool stays = oldThread->GetStatus() == RUNNING;
+    unsigned from = currentCpu;
+    unsigned to = from;
+    bool newRound = false;
+    bool found = false;
+    for (unsigned i = 1; i <= numCpus && !found; i++) {
+        to = (from + i) % numCpus;
+        if (to == 0) {
+            newRound = true;
+        }
+        if (to == from) {
+            found = stays || HasReady(to);
+        } else {
+            found = running[to] != nullptr || HasReady(to);
+        }
+    }
+    if (!found) {
+        interrupt->SetLevel(oldLevel);
+        return false;
+    }
+
+    unsigned long work = stats->userTicks + stats->systemTicks;
+    stats->cpuBusyTicks[from] += work - sliceWork;
+    sliceWork = work;
+    interrupt->StartSlice(CPU_SLICE, newRound);
+    if (to == from) {  // Nobody else has anything to do.
+        interrupt->SetLevel(oldLevel);
+        return false;
+    }
+
+    DEBUG('t', "Switching from CPU %u to CPU %u\n", from, to);
+    stats->numCpuSwitches++;
+
+    if (stays) {
+        running[from] = oldThread;
+    } else {
+#ifdef USER_PROGRAM
+        if (oldThread->space != nullptr) {
+            oldThread->SaveUserState();
+            oldThread->space->SaveState();
+        }
+#endif
+        running[from] = nullptr;
+    }
+
+    currentCpu = to;
+#ifdef USER_PROGRAM
+    if (machine != nullptr) {
+        machine->SelectCpu(to);
+    }
+#endif
+    Thread *nextThread = running[to];
+    running[to] = nullptr;
+    if (nextThread != nullptr) {
+        Dispatch(nextThread, false);
+    } else {
+        Dispatch(FindNextToRun(), true);
+    }
+
+    interrupt->SetLevel(oldLevel);
+    return true;
 }
 
+/// Print the scheduler state -- in other words, the contents of the ready
+/// list.  Only the queues that are not empty are shown.
+///
+/// For debugging.
 void
 Scheduler::Print()
 {
     printf("Ready list contents: \n");
-    for (int i = 0; i < NUM_COLAS; i++) {
-      printf("queue-%d:", i);
-      if (!queues[i]->IsEmpty()) {
-          queues[i]->Apply(ThreadPrint);
+    for (unsigned c = 0; c < numCpus && fairShare; c++) {
+      if (numCpus > 1) {
+        printf("cpu-%u ", c);
+      }
+      printf("heap:");
+      for (unsigned i = 0; i < queues[c].heapSize; i++) {
+        printf(" %lu:", queues[c].heap[i]->vruntime);
+        queues[c].heap[i]->Print();
       }
       printf("\n");
     }
+    for (unsigned c = 0; c < numCpus; c++) {
+      for (int i = 0; i < NUM_COLAS; i++) {
+        if (queues[c].head[i] == nullptr) {
+          continue;
+        }
+        if (numCpus > 1) {
+          printf("cpu-%u ", c);
+        }
+        printf("queue-%d:", i);
+        for (Thread *t = queues[c].head[i]; t != nullptr; t = t->readyNext) {
+          t->Print();
+        }
+        printf("\n");
+      }
+    }
     printf("\n");
 }
 
+void
+Scheduler::SetFeedback(unsigned newLevels, const unsigned *newQuanta,
+                       unsigned long newAgeTicks)
+{
+    ASSERT(newLevels <= NUM_COLAS);
+    ASSERT(newLevels == 0 || newQuanta != nullptr);
+    ASSERT(newLevels == 0 || !fairShare);
+
+    levels = newLevels;
+    for (unsigned i = 0; i < levels; i++) {
+        ASSERT(newQuanta[i] > 0);
+        quanta[levels - 1 - i] = newQuanta[i];
+    }
+    ageTicks = newAgeTicks;
+}
+
+/// Threads already waiting move to the structure of the new policy, in the
+/// order they would have run.
+void
+Scheduler::SetFairShare(bool on)
+{
+    ASSERT(!on || levels == 0);
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    for (unsigned c = 0; c < numCpus; c++) {
+        Thread *first = nullptr, *last = nullptr;
+        Thread *thread;
+        while ((thread = Pop(c)) != nullptr) {
+            thread->readyNext = nullptr;
+            if (last != nullptr) {
+                last->readyNext = thread;
+            } else {
+                first = thread;
+            }
+            last = thread;
+        }
+        fairShare = on;
+        while (first != nullptr) {
+            thread = first;
+            first = first->readyNext;
+            if (fairShare) {
+                thread->readyNext = nullptr;
+                HeapPush(c, thread);
+            } else {
+                Enqueue(c, thread, thread->GetPriority());
+            }
+        }
+    }
+    fairShare = on;
+    interrupt->SetLevel(oldLevel);
+}
+
+bool
+Scheduler::TimerTick()
+{
+    if (fairShare) {
+        Charge(currentThread);
+        const ReadyQueues *q = &queues[currentCpu];
+        return q->heapSize > 0
+                 && q->heap[0]->vruntime < currentThread->vruntime;
+    }
+    if (levels == 0) {
+        return true;
+    }
+    if (ageTicks > 0) {
+        Age();
+    }
+
+    Thread *thread = currentThread;
+    int p = thread->GetPriority();
+    bool yield = false;
+    if (p < (int) levels && ++thread->ticksUsed >= quanta[p]) {
+        if (p > 0) {
+            DEBUG('t', "Thread \"%s\" used up its quantum, moving to %d\n",
+                  thread->GetName(), p - 1);
+            thread->priority = p - 1;
+            stats->numDemotions++;
+        }
+        thread->ticksUsed = 0;
+        yield = true;
+    }
+    uint64_t above = ~(uint64_t) 0 << thread->GetPriority() << 1;
+    return yield || (queues[currentCpu].nonEmpty & above) != 0;
+}
+
+/// Levels are visited from the top down, so that a thread waits again
+/// before it moves up another level.
+///
+/// Waits are measured in work ticks, as CPU time is in `Charge`, because
+/// those never go back: the total ticks may, when they are restarted, and
+/// then an unsigned wait would look huge.
+void
+Scheduler::Age()
+{
+    unsigned long now = stats->userTicks + stats->systemTicks;
+    for (unsigned c = 0; c < numCpus; c++) {
+        for (int p = (int) levels - 2; p >= 0; p--) {
+            Thread *t;
+            while ((t = queues[c].head[p]) != nullptr
+                     && now - t->readySince >= ageTicks) {
+                Unlink(c, t, p);
+                t->priority = p + 1;
+                t->ticksUsed = 0;
+                Enqueue(c, t, p + 1);
+                stats->numPromotions++;
+            }
+        }
+    }
+}
+
+/// A thread that is not ready is in no queue; the new priority is used when
+/// it becomes ready.
 void
 Scheduler::ChangePriority(Thread *thread, int priority)
 {
-  queues[thread->GetPriority()]->Remove(thread);
-  queues[priority]->Append(thread);
+  ASSERT(thread != nullptr);
+  ASSERT(0 <= priority && priority < NUM_COLAS);
+
+  if (thread->GetStatus() != READY || fairShare) {
+    return;  // Ready threads are ordered by virtual runtime only.
+  }
+  Unlink(thread->GetCpu(), thread, thread->GetPriority());
+  Enqueue(thread->GetCpu(), thread, priority);
 }
@@ -12,17 +12,39 @@
 
 
 #include "thread.hh"
-#include "lib/list.hh"
-#define NUM_COLAS 5
+
+#include <stdint.h>
+
+
+/// Number of priorities, from 0 (the lowest) to `NUM_COLAS - 1`.
+///
+/// At most 64, one for each bit of `ReadyQueues::nonEmpty`.
+#define NUM_COLAS 64
 
 /// The following class defines the scheduler/dispatcher abstraction --
 /// the data structures and operations needed to keep track of which
 /// thread is running, and which threads are ready but not running.
+///
+/// The machine may have several CPUs.  Each one has its own ready queues
+/// and its own running thread; `currentThread` is the one of the CPU being
+/// simulated.  CPUs are simulated one at a time, taking turns of
+/// `CPU_SLICE` ticks (see `Interrupt::StartSlice`), so the interleaving is
+/// deterministic.
+///
+/// Each CPU keeps one FIFO queue per priority, linked through the threads
+/// themselves, and a bit mask of the queues that are not empty.  Queueing,
+/// picking the next thread and changing the priority of a ready thread take
+/// constant time, however many threads and priorities there are, and
+/// allocate no memory.
+///
+/// Priorities are static unless feedback queues are turned on (see
+/// `SetFeedback`).  Instead of strict priorities, threads may also get
+/// shares of the CPU in proportion to their priority (see `SetFairShare`).
 class Scheduler {
 public:
 
-    /// Initialize list of ready threads.
-    Scheduler();
+    /// Initialize list of ready threads, for `cpus` CPUs.
+    Scheduler(unsigned cpus = 1);
 
     /// De-allocate ready list.
     ~Scheduler();
@@ -36,14 +58,156 @@ public:
     /// Cause `nextThread` to start running.
     void Run(Thread *nextThread);
 
+    /// Let the next CPU that has a thread to run take its turn.
+    ///
+    /// Return false if no CPU but the current one has anything to do.
+    bool SwitchCpu();
+
+    /// Return the CPU being simulated.
+    unsigned GetCurrentCpu() const;
+
+    /// Turn on multilevel feedback queues, with `levels` levels.
+    ///
+    /// Levels are the priorities from `levels - 1` (the top) down to 0.
+    /// New threads start at the top.  A thread that runs for `quanta[i]`
+    /// timer interrupts at the level `i` levels below the top moves one
+    /// level down; one that waits in a ready queue while `ageTicks` ticks
+    /// of work are done moves one level up.  So threads that use the CPU in short bursts,
+    /// such as interactive ones, stay above those that use it to compute.
+    ///
+    /// With `levels` 0, priorities become static again.
+    void SetFeedback(unsigned levels, const unsigned *quanta,
+                     unsigned long ageTicks);
+
+    /// Turn the fair-share policy on or off.
+    ///
+    /// With it, each CPU runs first the ready thread with the least virtual
+    /// runtime: the ticks of work the thread has done, divided by its
+    /// priority plus one.  So, over time, a thread of priority `p` gets
+    /// `p + 1` shares of the CPU.  Cannot be used with feedback queues.
+    void SetFairShare(bool on);
+
+#ifdef USER_PROGRAM
+    /// Prefer, among the ready threads of the highest priority, those whose
+    /// address space is already loaded in the MMU, so that switching to
+    /// them needs no `AddressSpace::RestoreState`.
+    ///
+    /// Only the first `AFFINITY_SCAN` threads of the queue are looked at,
+    /// and the thread at its head is passed over at most `bound` times, so
+    /// no thread waits for long.  With `bound` 0, threads run in FIFO
+    /// order.  Not used with the fair-share policy.
+    void SetAffinity(unsigned bound);
+#endif
+
+    /// Account for a timer interrupt, and return whether the current
+    /// thread should yield.
+    ///
+    /// With static priorities, it always should.  With feedback queues,
+    /// only if it used up its quantum, or a thread of a higher level is
+    /// ready.  With fair shares, only if a ready thread has run less.
+    bool TimerTick();
+
+    /// Move `thread` to the queue of `priority`, if it is ready to run.
+    ///
+    /// Its own priority is not changed; see `Thread::ChangePriority`.
     void ChangePriority(Thread *thread, int priority);
-    
+
     // Print contents of ready list.
     void Print();
 
 private:
 
-    List<Thread *> *queues[NUM_COLAS];
+    /// The ready threads of a CPU.
+    struct ReadyQueues {
+        Thread *head[NUM_COLAS];  ///< First and last thread of each
+        Thread *tail[NUM_COLAS];  ///< priority, or null if there is none.
+        uint64_t nonEmpty;        ///< Bit `i` set if `head[i]` is not null.
+
+        /// With fair shares, binary min-heap of the ready threads, ordered
+        /// by virtual runtime, with room for `heapCapacity`; and the least
+        /// virtual runtime a thread picked to run has had.
+        Thread **heap;
+        unsigned heapSize;
+        unsigned heapCapacity;
+        unsigned long minVruntime;
+    };
+
+    /// Put `thread` at the end of the queue of `priority` of CPU `cpu`.
+    void Enqueue(unsigned cpu, Thread *thread, int priority);
+
+    /// Take `thread` out of the queue of `priority` of CPU `cpu`.
+    void Unlink(unsigned cpu, Thread *thread, int priority);
+
+    /// Return whether CPU `cpu` has threads ready to run.
+    bool HasReady(unsigned cpu) const;
+
+    /// Order of the heap.
+    static bool RunsBefore(const Thread *a, const Thread *b);
+
+    /// Add `thread` to the heap of CPU `cpu`.
+    void HeapPush(unsigned cpu, Thread *thread);
+
+    /// Take the thread with the least virtual runtime out of the heap of
+    /// CPU `cpu`, which must not be empty.
+    Thread *HeapPop(unsigned cpu);
+
+    /// Take the next thread to run out of the ready threads of CPU `cpu`,
+    /// or return null if there is none.
+    Thread *Pop(unsigned cpu);
+
+#ifdef USER_PROGRAM
+    /// Return the thread to run from the queue starting at `head`, which
+    /// may be a later one of the address space loaded in the MMU.
+    Thread *PickAffine(Thread *head);
+
+    /// Threads of a queue looked at by `PickAffine`.
+    static const unsigned AFFINITY_SCAN = 8;
+
+    /// Times the head of a queue may be passed over, or 0 if no thread is.
+    unsigned affinityBound;
+#endif
+
+    /// Add the work done by the machine since `thread` was last charged to
+    /// its CPU time.
+    void Charge(Thread *thread);
+
+    /// Move the threads that waited too long one level up.
+    void Age();
+
+    /// Switch to `nextThread` on the current CPU.  If `restore`, the user
+    /// state of the thread is loaded into the CPU once it resumes.
+    void Dispatch(Thread *nextThread, bool restore);
+
+    /// Ready queues of each CPU.
+    ReadyQueues *queues;
+
+    /// Feedback queues, if `levels` is not 0: quantum of each priority,
+    /// in timer interrupts, and ticks after which waiting threads move up.
+    unsigned levels;
+    unsigned quanta[NUM_COLAS];
+    unsigned long ageTicks;
+
+    /// Whether the fair-share policy is on, and how many threads have been
+    /// queued, to break ties between equal virtual runtimes in FIFO order.
+    bool fairShare;
+    unsigned long queued;
+
+    unsigned numCpus;
+    unsigned currentCpu;
+
+    /// CPU to which the next new thread will be assigned.
+    unsigned nextCpu;
+
+    /// Thread left running on each CPU while another CPU is simulated, or
+    /// null if the CPU is idle.
+    Thread **running;
+
+    /// Whether the thread being resumed by `Dispatch` must load its user
+    /// state, or it finds it in the registers of its CPU, untouched.
+    bool restoreOnResume;
+
+    /// Ticks of work done by all CPUs when the current slice started.
+    unsigned long sliceWork;
 };
 
 
@@ -0,0 +1,90 @@
+/// Routines to pool the stacks of kernel threads.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "stack_pool.hh"
+#include "system.hh"
+
+
+StackPool::StackPool(unsigned words_, unsigned warm, unsigned maxIdle_)
+{
+    ASSERT(words_ >= 64);
+
+    words = words_;
+    maxIdle = maxIdle_ > warm ? maxIdle_ : warm;
+    idle = nullptr;
+    numIdle = 0;
+    for (unsigned i = 0; i < warm; i++) {
+        uintptr_t *stack = Allocate();
+        stack[1] = (uintptr_t) idle;
+        idle = stack;
+        numIdle++;
+    }
+}
+
+StackPool::~StackPool()
+{
+    while (idle != nullptr) {
+        uintptr_t *next = (uintptr_t *) idle[1];
+        Free(idle);
+        idle = next;
+    }
+}
+
+uintptr_t *
+StackPool::Get()
+{
+    if (idle == nullptr) {
+        return Allocate();
+    }
+    uintptr_t *stack = idle;
+    idle = (uintptr_t *) stack[1];
+    numIdle--;
+    stats->reusedStacks++;
+    return stack;
+}
+
+/// A stack whose fence post was overwritten may have corrupted the memory
+/// below it, so it is not reused silently.
+void
+StackPool::Put(uintptr_t *stack)
+{
+    ASSERT(stack != nullptr);
+    ASSERT(*stack == STACK_FENCEPOST);
+
+    if (numIdle >= maxIdle) {
+        Free(stack);
+        return;
+    }
+    stack[1] = (uintptr_t) idle;
+    idle = stack;
+    numIdle++;
+}
+
+unsigned
+StackPool::GetWords() const
+{
+    return words;
+}
+
+unsigned
+StackPool::CountIdle() const
+{
+    return numIdle;
+}
+
+uintptr_t *
+StackPool::Allocate()
+{
+    stats->allocatedStacks++;
+    return (uintptr_t *) SystemDep::AllocBoundedArray(words * sizeof (uintptr_t));
+}
+
+void
+StackPool::Free(uintptr_t *stack)
+{
+    SystemDep::DeallocBoundedArray((char *) stack, words * sizeof (uintptr_t));
+}
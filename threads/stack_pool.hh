@@ -0,0 +1,68 @@
+/// Pool of execution stacks for kernel threads.
+///
+/// Allocating a stack maps a guard page at each end of it (see
+/// `SystemDep::AllocBoundedArray`), which is most of the cost of creating a
+/// thread.  Instead of freeing the stack of a thread that finished, the
+/// pool keeps it for the next thread, so that programs that keep creating
+/// short-lived threads only allocate as many stacks as threads are alive
+/// at once.  A number of stacks can be allocated up front, and at most a
+/// given number of stacks are kept idle, so that the memory held after a
+/// burst of threads is bounded.
+///
+/// All stacks of a pool have the same size, which can be made smaller than
+/// `STACK_SIZE` to fit more threads in memory.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_STACKPOOL__HH
+#define NACHOS_THREADS_STACKPOOL__HH
+
+
+#include <stdint.h>
+
+
+class StackPool {
+public:
+
+    /// Create a pool of stacks of `words` words, with `warm` of them
+    /// allocated already, keeping at most `maxIdle` idle stacks (or `warm`,
+    /// if greater).
+    StackPool(unsigned words, unsigned warm, unsigned maxIdle);
+
+    /// De-allocate the idle stacks.
+    ~StackPool();
+
+    /// Return a stack, reused if there is an idle one.
+    uintptr_t *Get();
+
+    /// Give back `stack`, which must have been returned by `Get`, and whose
+    /// lowest word must still be the fence post of its thread.
+    void Put(uintptr_t *stack);
+
+    /// Return the size of the stacks, in words.
+    unsigned GetWords() const;
+
+    /// Return how many idle stacks the pool keeps.
+    unsigned CountIdle() const;
+
+private:
+
+    /// Allocate a new stack.
+    uintptr_t *Allocate();
+
+    /// De-allocate `stack`.
+    void Free(uintptr_t *stack);
+
+    unsigned words;
+    unsigned maxIdle;
+
+    /// Idle stacks, linked through their second word (the first one is the
+    /// fence post), and how many there are.
+    uintptr_t *idle;
+    unsigned numIdle;
+};
+
+
+#endif
@@ -10,6 +10,7 @@
 #include "preemptive.hh"
 
 #ifdef USER_PROGRAM
+#include "userprog/checkpoint.hh"
 #include "userprog/debugger.hh"
 #include "userprog/exception.hh"
 #include "machine/mmu.hh"
@@ -30,11 +31,18 @@ Interrupt *interrupt;         ///< Interrupt status.
 Statistics *stats;            ///< Performance metrics.
 Timer *timer;                 ///< The hardware timer device, for invoking
                               ///< context switches.
+StackPool *stackPool;         ///< Stacks of kernel threads.
 
 // 2007, Jose Miguel Santos Espino
 PreemptiveScheduler *preemptiveScheduler = nullptr;
 const long long DEFAULT_TIME_SLICE = 50000;
 
+/// Ticks a thread waits in a feedback queue before moving up a level.
+const unsigned long DEFAULT_AGE_TICKS = 2000;
+
+/// Idle thread stacks kept for reuse, unless more are preallocated.
+const unsigned MAX_IDLE_STACKS = 256;
+
 #ifdef FILESYS_NEEDED
 FileSystem *fileSystem;
 #endif
@@ -52,6 +60,19 @@ Bitmap *pagesInUse;
 CoreMapEntry *pagesInUse;
 #endif
 
+#ifdef SHARED_TEXT
+TextCache *textCache;
+#endif
+#ifdef COPY_ON_WRITE
+FrameRefs *frameRefs;
+#endif
+#ifdef EXEC_CACHE
+ImageCache *imageCache;
+#endif
+#if defined(SHARED_TEXT) || defined(EXEC_CACHE)
+OpenNames *openNames;
+#endif
+
 Table<Thread *> *runningProcesses;
 SynchConsole *synchConsole;
 #endif
@@ -80,7 +101,7 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(void *dummy)
 {
-    if (interrupt->GetStatus() != IDLE_MODE) {
+    if (interrupt->GetStatus() != IDLE_MODE && scheduler->TimerTick()) {
         interrupt->YieldOnReturn();
     }
 }
@@ -144,9 +165,35 @@ Initialize(int argc, char **argv)
     // 2007, Jose Miguel Santos Espino
     bool preemptiveScheduling = false;
     long long timeSlice;
+    unsigned numCpus = 1;  // Number of simulated CPUs.
+    unsigned levels = 0;  // Feedback queues, and their quanta.
+    unsigned quanta[NUM_COLAS];
+    unsigned long ageTicks = DEFAULT_AGE_TICKS;
+    bool fairShare = false;  // Proportional shares instead of priorities.
+    unsigned stackWords = STACK_SIZE;  // Thread stacks.
+    unsigned warmStacks = 0;
 
 #ifdef USER_PROGRAM
     bool debugUserProg = false;  // Single step user program.
+    bool threadedDispatch = false;  // Use the threaded-code engine.
+    bool burstTicks = false;  // Charge user ticks in bursts.
+    unsigned affinityBound = 0;  // Address space affinity.
+    unsigned physPages = DEFAULT_NUM_PHYS_PAGES;  // Memory layout.
+    unsigned bytesPerPage = DEFAULT_PAGE_SIZE;
+    const char *profileName = nullptr;  // Profile user programs.
+    const char *profileSymbols = nullptr;
+    const char *traceName = nullptr;  // Record a binary trace.
+    bool traceDelta = false;
+    const char *checkpointName = nullptr;  // Checkpoint to write.
+    unsigned long checkpointTick = 0;
+#ifdef FILESYS
+    const char *resumeName = nullptr;  // Checkpoint to resume.
+#endif
+#endif
+#ifdef USE_TLB
+    unsigned tlbEntries = TLB_SIZE;  // TLB layout.
+    unsigned tlbWays = TLB_SIZE;
+    TLBPolicy tlbPolicy = TLB_FIFO;
 #endif
 #ifdef FILESYS_NEEDED
     bool format = false;  // Format disk.
@@ -176,10 +223,40 @@ Initialize(int argc, char **argv)
             // Initialize pseudo-random number generator.
             randomYield = true;
             argCount = 2;
+        } else if (!strcmp(*argv, "-smp")) {
+            ASSERT(argc > 1);
+            numCpus = atoi(*(argv + 1));
+            ASSERT(numCpus > 0);
+            argCount = 2;
         } else if (!strcmp(*argv, "-ts")) {
             ASSERT(argc > 1);
             timeSliceDef = true;
             argCount = 2;
+        } else if (!strcmp(*argv, "-mlfq")) {
+            ASSERT(argc > 1);
+            for (char *s = *(argv + 1); *s != '\0'; s++) {
+                ASSERT(levels < NUM_COLAS);
+                quanta[levels++] = strtoul(s, &s, 10);
+                ASSERT(quanta[levels - 1] > 0);
+                if (*s != ',') {
+                    ASSERT(*s == '\0');
+                    break;
+                }
+            }
+            timeSliceDef = true;
+            argCount = 2;
+        } else if (!strcmp(*argv, "-age")) {
+            ASSERT(argc > 1);
+            ageTicks = atol(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-fair")) {
+            fairShare = true;
+            timeSliceDef = true;
+        } else if (!strcmp(*argv, "-stk")) {
+            ASSERT(argc > 2);
+            stackWords = atoi(*(argv + 1));
+            warmStacks = atoi(*(argv + 2));
+            argCount = 3;
         }
         // 2007, Jose Miguel Santos Espino
         else if (!strcmp(*argv, "-p")) {
@@ -194,6 +271,67 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-s")) {
             debugUserProg = true;
+        } else if (!strcmp(*argv, "-th")) {
+            threadedDispatch = true;
+        } else if (!strcmp(*argv, "-bt")) {
+            burstTicks = true;
+        } else if (!strcmp(*argv, "-af")) {
+            ASSERT(argc > 1);
+            affinityBound = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-mp")) {
+            ASSERT(argc > 1);
+            physPages = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-ps")) {
+            ASSERT(argc > 1);
+            bytesPerPage = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-prof")) {
+            ASSERT(argc > 1);
+            profileName = *(argv + 1);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-profsym")) {
+            ASSERT(argc > 1);
+            profileSymbols = *(argv + 1);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tr") || !strcmp(*argv, "-trd")) {
+            ASSERT(argc > 1);
+            traceName = *(argv + 1);
+            traceDelta = !strcmp(*argv, "-trd");
+            argCount = 2;
+        } else if (!strcmp(*argv, "-ckpt")) {
+            ASSERT(argc > 2);
+            checkpointName = *(argv + 1);
+            checkpointTick = atol(*(argv + 2));
+            argCount = 3;
+        }
+#ifdef FILESYS
+        if (!strcmp(*argv, "-resume")) {
+            ASSERT(argc > 1);
+            resumeName = *(argv + 1);
+            argCount = 2;
+        }
+#endif
+#endif
+#ifdef USE_TLB
+        if (!strcmp(*argv, "-tlb")) {
+            ASSERT(argc > 2);
+            tlbEntries = atoi(*(argv + 1));
+            tlbWays = atoi(*(argv + 2));
+            argCount = 3;
+        } else if (!strcmp(*argv, "-tlbp")) {
+            ASSERT(argc > 1);
+            const char *name = *(argv + 1);
+            if (!strcmp(name, "fifo")) {
+                tlbPolicy = TLB_FIFO;
+            } else if (!strcmp(name, "lru")) {
+                tlbPolicy = TLB_LRU;
+            } else {
+                ASSERT(!strcmp(name, "random"));
+                tlbPolicy = TLB_RANDOM;
+            }
+            argCount = 2;
         }
 #endif
 #ifdef FILESYS_NEEDED
@@ -217,8 +355,20 @@ Initialize(int argc, char **argv)
     debug.SetFlags(debugFlags);  // Initialize `DEBUG` messages.
     debug.SetOpts(debugOpts);    // Set debugging behavior.
     stats = new Statistics;      // Collect statistics.
+    stats->InitCpus(numCpus);
     interrupt = new Interrupt;   // Start up interrupt handling.
-    scheduler = new Scheduler;   // Initialize the ready queue.
+    stackPool = new StackPool(stackWords, warmStacks, MAX_IDLE_STACKS);
+    scheduler = new Scheduler(numCpus);  // Initialize the ready queue.
+    if (levels > 0) {
+        scheduler->SetFeedback(levels, quanta, ageTicks);
+    }
+    if (fairShare) {
+        ASSERT(levels == 0);
+        scheduler->SetFairShare(true);
+    }
+    if (numCpus > 1) {           // Start interleaving the CPUs.
+        interrupt->StartSlice(CPU_SLICE, true);
+    }
     if (randomYield) {           // Start the timer (if needed).
         timer = new Timer(TimerInterruptHandler, 0, randomYield);
     }
@@ -245,12 +395,40 @@ Initialize(int argc, char **argv)
 
 #ifdef USER_PROGRAM
     Debugger *d = debugUserProg ? new Debugger : nullptr;
-    machine = new Machine(d);  // This must come first.
+    SetMemoryLayout(physPages, bytesPerPage);
+    machine = new Machine(d, threadedDispatch, burstTicks, numCpus);
+      // This must come first.
+    if (profileName != nullptr) {
+        machine->StartProfiling(profileName, profileSymbols);
+    }
+    if (traceName != nullptr) {
+        machine->StartTracing(traceName, traceDelta);
+    }
+    if (checkpointName != nullptr) {
+        ASSERT(numCpus == 1);
+        ScheduleCheckpoint(checkpointName, checkpointTick);
+    }
+    scheduler->SetAffinity(affinityBound);
+#ifdef USE_TLB
+    machine->GetMMU()->ConfigureTLB(tlbEntries, tlbWays, tlbPolicy);
+#endif
 
     #ifndef SWAP
-    pagesInUse = new Bitmap(NUM_PHYS_PAGES);
+    pagesInUse = new Bitmap(numPhysPages);
     #else
-    pagesInUse = new CoreMapEntry[NUM_PHYS_PAGES];
+    pagesInUse = new CoreMapEntry[numPhysPages];
+    #endif
+    #ifdef SHARED_TEXT
+    textCache = new TextCache;
+    #endif
+    #ifdef COPY_ON_WRITE
+    frameRefs = new FrameRefs;
+    #endif
+    #ifdef EXEC_CACHE
+    imageCache = new ImageCache;
+    #endif
+    #if defined(SHARED_TEXT) || defined(EXEC_CACHE)
+    openNames = new OpenNames;
     #endif
 
     SetExceptionHandlers();
@@ -261,6 +439,11 @@ Initialize(int argc, char **argv)
 
 
 #ifdef FILESYS
+#ifdef USER_PROGRAM
+    if (resumeName != nullptr) {
+        RestoreDiskImage(resumeName);  // Before the disk is started.
+    }
+#endif
     synchDisk = new SynchDisk("DISK");
 #endif
 
@@ -288,6 +471,18 @@ Cleanup()
 
 #ifdef USER_PROGRAM
     delete machine;
+    #ifdef SHARED_TEXT
+    delete textCache;
+    #endif
+    #ifdef COPY_ON_WRITE
+    delete frameRefs;
+    #endif
+    #ifdef EXEC_CACHE
+    delete imageCache;
+    #endif
+    #if defined(SHARED_TEXT) || defined(EXEC_CACHE)
+    delete openNames;
+    #endif
     delete pagesInUse;
     delete synchConsole;
     delete runningProcesses;
@@ -303,6 +498,7 @@ Cleanup()
 
     delete timer;
     delete scheduler;
+    delete stackPool;
     delete interrupt;
 
     exit(0);
@@ -11,6 +11,7 @@
 
 #include "thread.hh"
 #include "scheduler.hh"
+#include "stack_pool.hh"
 #include "lib/utility.hh"
 #include "machine/interrupt.hh"
 #include "machine/statistics.hh"
@@ -32,10 +33,6 @@ extern void Cleanup();
 typedef struct {
     SpaceId spaceId;
     unsigned virtualPage;
-#ifdef PRPOLICY_LRU
-    unsigned last_use_counter;  // this will represent the last recently use page.
-                                // to search for the victim we will search directly for the minimun value of the array
-#endif
 } CoreMapEntry;
 #endif
 
@@ -45,6 +42,7 @@ extern Scheduler *scheduler;         ///< The ready list.
 extern Interrupt *interrupt;         ///< Interrupt status.
 extern Statistics *stats;            ///< Performance metrics.
 extern Timer *timer;                 ///< The hardware alarm clock.
+extern StackPool *stackPool;         ///< Stacks of kernel threads.
 
 #ifdef USER_PROGRAM
 #include "machine/machine.hh"
@@ -57,6 +55,22 @@ extern Bitmap *pagesInUse;
 #else
 extern CoreMapEntry *pagesInUse;
 #endif
+#ifdef SHARED_TEXT
+#include "userprog/text_cache.hh"
+extern TextCache *textCache;
+#endif
+#ifdef COPY_ON_WRITE
+#include "userprog/frame_refs.hh"
+extern FrameRefs *frameRefs;
+#endif
+#ifdef EXEC_CACHE
+#include "userprog/image_cache.hh"
+extern ImageCache *imageCache;
+#endif
+#if defined(SHARED_TEXT) || defined(EXEC_CACHE)
+#include "userprog/open_names.hh"
+extern OpenNames *openNames;
+#endif
 #endif
 
 #ifdef FILESYS_NEEDED  // *FILESYS* or *FILESYS_STUB*.
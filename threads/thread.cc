@@ -28,10 +28,6 @@
 #include <stdio.h>
 
 
-/// This is put at the top of the execution stack, for detecting stack
-/// overflows.
-const unsigned STACK_FENCEPOST = 0xDEADBEEF;
-
 //Channel *canal = new Channel("canal");
 
 static inline bool
@@ -50,9 +46,19 @@ Thread::Thread(const char *threadName, bool state, int pr)
     stackTop = nullptr;
     stack    = nullptr;
     status   = JUST_CREATED;
+    cpu      = 0;
     joinable = state;
-    priority = pr > NUM_COLAS || pr < 0 ? 0 : pr;
+    holds    = joinable ? 2 : 1;
+    priority = pr >= NUM_COLAS || pr < 0 ? 0 : pr;
+    readyNext = readyPrev = nullptr;
+    ticksUsed = 0;
+    readySince = 0;
+    cpuTicks = vruntime = runStart = readyOrder = 0;
+#ifdef USER_PROGRAM
+    passedOver = 0;
+#endif
 
+    canal = nullptr;
     if (joinable) {//create a channel to let the thread know when fork finishes
       canal = new Channel("canal");
     }
@@ -76,12 +82,12 @@ Thread::Thread(const char *threadName, bool state, int pr)
 /// Nachos.
 Thread::~Thread()
 {
-    DEBUG('t', "Deleting thread \"%s\"\n", name);
+    DEBUG('t', "Deleting thread \"%s\", which ran for %lu ticks\n",
+          name, cpuTicks);
 
     ASSERT(this != currentThread);
     if (stack != nullptr) {
-        SystemDep::DeallocBoundedArray((char *) stack,
-                                       STACK_SIZE * sizeof *stack);
+        stackPool->Put(stack);
     }
     #ifdef USER_PROGRAM
     delete space;
@@ -89,8 +95,8 @@ Thread::~Thread()
 
     runningProcesses->Remove(this->Pid);
     delete files;
-    //delete canal;
     #endif
+    delete canal;
 
 }
 
@@ -153,12 +159,30 @@ Thread::SetStatus(ThreadStatus st)
     status = st;
 }
 
+ThreadStatus
+Thread::GetStatus() const
+{
+    return status;
+}
+
 const char *
 Thread::GetName() const
 {
     return name;
 }
 
+unsigned
+Thread::GetCpu() const
+{
+    return cpu;
+}
+
+void
+Thread::SetCpu(unsigned c)
+{
+    cpu = c;
+}
+
 int
 Thread::GetPriority()
 {
@@ -167,6 +191,17 @@ Thread::GetPriority()
 
 
 
+/// Work is charged when the thread leaves the CPU; the current thread also
+/// counts what it did since.
+unsigned long
+Thread::GetCpuTicks() const
+{
+    if (this != currentThread) {
+        return cpuTicks;
+    }
+    return cpuTicks + stats->userTicks + stats->systemTicks - runStart;
+}
+
 void
 Thread::Print() const
 {
@@ -179,8 +214,9 @@ Thread::Print() const
 /// NOTE: we do not immediately de-allocate the thread data structure or the
 /// execution stack, because we are still running in the thread and we are
 /// still on the stack!  Instead, we set `threadToBeDestroyed`, so that
-/// `Scheduler::Run` will call the destructor, once we are running in the
-/// context of a different thread.
+/// `Scheduler::Run` will let go of it, once we are running in the context
+/// of a different thread.  A joinable thread is only deleted once it has
+/// also been joined (see `Drop`).
 ///
 /// NOTE: we disable interrupts, so that we do not get a time slice between
 /// setting `threadToBeDestroyed`, and going to sleep.
@@ -242,9 +278,11 @@ Thread::Yield()
 /// ready queue, so that it can be re-scheduled.
 ///
 /// NOTE: if there are no threads on the ready queue, that means we have no
-/// thread to run.  `Interrupt::Idle` is called to signify that we should
-/// idle the CPU until the next I/O interrupt occurs (the only thing that
-/// could cause a thread to become ready to run).
+/// thread to run.  If another CPU has work, this one is left idle and the
+/// simulation goes on with the other.  Otherwise, `Interrupt::Idle` is
+/// called to signify that we should idle the CPU until the next I/O
+/// interrupt occurs (the only thing that could cause a thread to become
+/// ready to run).
 ///
 /// NOTE: we assume interrupts are already disabled, because it is called
 /// from the synchronization routines which must disable interrupts for
@@ -261,6 +299,9 @@ Thread::Sleep()
     Thread *nextThread;
     status = BLOCKED;
     while ((nextThread = scheduler->FindNextToRun()) == nullptr) {
+        if (scheduler->SwitchCpu()) {
+            return;  // Returns when we have been signalled.
+        }
         interrupt->Idle();  // No one to run, wait for an interrupt.
     }
 
@@ -270,8 +311,21 @@ Thread::Sleep()
 void
 Thread::Join()
 {
+    ASSERT(joinable);
+
     int finished;
     canal->Receive(&finished);
+    Drop();
+}
+
+void
+Thread::Drop()
+{
+    ASSERT(holds > 0);
+
+    if (--holds == 0) {
+        delete this;
+    }
 }
 
 void
@@ -306,9 +360,16 @@ ThreadFinish()
 
 }
 
+/// A new thread starts here rather than returning into `Scheduler::Dispatch`,
+/// so it also lets go of the thread that finished and switched to it, if any;
+/// otherwise its stack would never go back to the pool.
 static void
 InterruptEnable()
 {
+    if (threadToBeDestroyed != nullptr) {
+        threadToBeDestroyed->Drop();
+        threadToBeDestroyed = nullptr;
+    }
     interrupt->Enable();
 }
 
@@ -327,11 +388,10 @@ Thread::StackAllocate(VoidFunctionPtr func, void *arg)
 {
     ASSERT(func != nullptr);
 
-    stack = (uintptr_t *)
-              SystemDep::AllocBoundedArray(STACK_SIZE * sizeof *stack);
+    stack = stackPool->Get();
 
     // Stacks in x86 work from high addresses to low addresses.
-    stackTop = stack + STACK_SIZE - 4;  // -4 to be on the safe side!
+    stackTop = stack + stackPool->GetWords() - 4;  // -4 to be on the safe side!
 
     // x86 passes the return address on the stack.  In order for `SWITCH` to
     // go to `ThreadRoot` when we switch to this thread, the return address
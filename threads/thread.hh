@@ -65,8 +65,15 @@ const unsigned MACHINE_STATE_SIZE = 17;
 /// In words.
 ///
 /// WATCH OUT IF THIS IS NOT BIG ENOUGH!!!!!
+///
+/// This is the default; the size can be changed for all threads (see
+/// `StackPool`).
 const unsigned STACK_SIZE = 4 * 1024;
 
+/// This is put at the top of the execution stack, for detecting stack
+/// overflows.
+const unsigned STACK_FENCEPOST = 0xDEADBEEF;
+
 
 /// Thread state.
 enum ThreadStatus {
@@ -129,8 +136,16 @@ public:
 
     void SetStatus(ThreadStatus st);
 
+    ThreadStatus GetStatus() const;
+
     const char *GetName() const;
 
+    /// CPU whose ready queues hold the thread while it waits to run, which
+    /// is the CPU it ran on last.
+    unsigned GetCpu() const;
+
+    void SetCpu(unsigned c);
+
     int GetPriority();
 
 
@@ -140,8 +155,21 @@ public:
 
     void Print() const;
 
+    /// Wait for a joinable thread to finish, and let go of it.
     void Join();
 
+    /// Let go of the thread once it has finished, deleting it when nobody
+    /// needs it any more.
+    ///
+    /// A finished thread is needed by the thread that switched away from
+    /// it (see `threadToBeDestroyed`) and, if it is joinable, by the one
+    /// that joins it, which still has to receive from its channel.  Its
+    /// stack only goes back to the pool when both are done with it.
+    void Drop();
+
+    /// Ticks of user and kernel work the thread has done so far.
+    unsigned long GetCpuTicks() const;
+
 private:
     // Some of the private data for this class is listed above.
 
@@ -153,19 +181,50 @@ private:
     /// Ready, running or blocked.
     ThreadStatus status;
 
+    unsigned cpu;
+
     const char *name;
 
     Channel *canal;
 
     bool joinable;
 
+    /// Threads that still need the thread once it has finished, see
+    /// `Drop`.
+    unsigned holds;
+
     int priority;
 
     int backupPriority;
 
+    /// Neighbours in the ready queue holding the thread, if it is ready.
+    /// Kept by `Scheduler`, so that queueing a thread allocates nothing.
+    Thread *readyNext;
+    Thread *readyPrev;
+
+    /// With feedback queues, timer interrupts the thread has run for at its
+    /// current level, and the ticks of work done, by every CPU, when it was
+    /// last queued.  Work ticks never go back, unlike `totalTicks`.
+    unsigned ticksUsed;
+    unsigned long readySince;
+
+    /// CPU time accounting: ticks of work done, the same weighted by
+    /// priority for the fair-share policy, work done by the machine when the
+    /// thread was last charged, and the order it was last queued in.
+    unsigned long cpuTicks;
+    unsigned long vruntime;
+    unsigned long runStart;
+    unsigned long readyOrder;
+
+#ifdef USER_PROGRAM
+    /// Times the thread, at the head of its ready queue, was passed over
+    /// for a thread of the address space loaded in the MMU.
+    unsigned passedOver;
+#endif
+    friend class Scheduler;
 
 
-    /// Allocate a stack for thread.  Used internally by `Fork`.
+    /// Take a stack for thread from `stackPool`.  Used internally by `Fork`.
     void StackAllocate(VoidFunctionPtr func, void *arg);
 
 #ifdef USER_PROGRAM
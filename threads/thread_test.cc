@@ -18,6 +18,11 @@
 #include "thread_test_channel.hh"
 #include "thread_test_join.hh"
 #include "thread_test_change_priority.hh"
+#include "thread_test_debug.hh"
+#include "thread_test_sched.hh"
+#include "thread_test_mlfq.hh"
+#include "thread_test_fair.hh"
+#include "thread_test_stacks.hh"
 #include "lib/utility.hh"
 #include <stdio.h>
 #include <stdlib.h>
@@ -37,7 +42,12 @@ static const Test TESTS[] = {
     { &ThreadTestGardenSem, "gardenSem", "Ornamental garden with semaphores"},
     { &ThreadTestChannel, "channel", "Channel test with 2 threads"},
     { &ThreadTestJoin, "Join", "test with join threads"},
-    { &ThreadTestChangePriority, "ChangePriority", "change thread priority test"}
+    { &ThreadTestChangePriority, "ChangePriority", "change thread priority test"},
+    { &ThreadTestDebug, "debug", "Cost of disabled debug messages"},
+    { &ThreadTestSched, "sched", "Scheduler with thousands of ready threads"},
+    { &ThreadTestMlfq, "mlfq", "Feedback queues against round robin"},
+    { &ThreadTestFair, "fair", "Shares of the CPU by priority"},
+    { &ThreadTestStacks, "stacks", "Thread creation with pooled stacks"}
 };
 static const unsigned NUM_TESTS = sizeof TESTS / sizeof TESTS[0];
 
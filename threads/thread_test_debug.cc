@@ -0,0 +1,103 @@
+/// Test and benchmark of debug messages that are turned off.
+///
+/// Checks that flags are enabled as `-d` lists them, and that a `DEBUG`
+/// message whose flag is disabled does not even evaluate its arguments.
+/// Then runs the same loop with no debug message, with a disabled `DEBUG`
+/// message, and with the string search that used to decide whether a flag
+/// was enabled, and prints what each iteration costs.  Build with
+/// `DEBUG_FLAGS` defined to see the cost of a message that is compiled out.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "thread_test_debug.hh"
+#include "thread_test_timing.hh"
+#include "system.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+static const unsigned ITERATIONS = 50000000;
+
+/// Flags as given to `-d` that leave `m` disabled.
+static const char TEST_FLAGS[] = "tsiade";
+
+/// Times the arguments of a debug message were evaluated.
+static unsigned evaluated;
+
+static unsigned
+Evaluate()
+{
+    return ++evaluated;
+}
+
+/// The check done by `Debug::IsEnabled` before it kept a bit mask.
+static bool
+SearchFlags(const char *flags, char flag)
+{
+    return strchr(flags, flag) != 0 || strchr(flags, '+') != 0;
+}
+
+/// Check which flags each set of flags enables.
+static void
+CheckFlags()
+{
+    debug.SetFlags(TEST_FLAGS);
+    for (const char *f = TEST_FLAGS; *f != '\0'; f++) {
+        ASSERT(debug.IsEnabled(*f) == Debug::IsCompiledIn(*f));
+    }
+    ASSERT(!debug.IsEnabled('m'));
+    ASSERT(!debug.IsEnabled('n'));
+
+    debug.SetFlags("+");
+    ASSERT(debug.IsEnabled('m') == Debug::IsCompiledIn('m'));
+    ASSERT(debug.IsEnabled('n') == Debug::IsCompiledIn('n'));
+
+    debug.SetFlags("");
+    ASSERT(!debug.IsEnabled('t'));
+
+    // A disabled message must cost no more than the check of its flag.
+    debug.SetFlags(TEST_FLAGS);
+    evaluated = 0;
+    for (unsigned i = 0; i < 1000; i++) {
+        DEBUG('m', "Evaluated %u times\n", Evaluate());
+    }
+    ASSERT(evaluated == 0);
+}
+
+void
+ThreadTestDebug()
+{
+    const char *oldFlags = debug.GetFlags();
+    CheckFlags();
+
+    debug.SetFlags(TEST_FLAGS);
+    volatile unsigned sum = 0;
+
+    Stopwatch watch;
+    for (unsigned i = 0; i < ITERATIONS; i++) {
+        sum += i;
+    }
+    watch.Report("No debug message:", ITERATIONS, "iteration");
+
+    for (unsigned i = 0; i < ITERATIONS; i++) {
+        sum += i;
+        DEBUG('m', "Iteration %u, sum %u\n", i, sum);
+    }
+    watch.Report(Debug::IsCompiledIn('m') ? "Disabled debug message:"
+                                          : "Compiled out debug message:",
+                 ITERATIONS, "iteration");
+
+    for (unsigned i = 0; i < ITERATIONS; i++) {
+        sum += i;
+        if (SearchFlags(TEST_FLAGS, 'm')) {
+            printf("Iteration %u, sum %u\n", i, sum);
+        }
+    }
+    watch.Report("Flag found by string search:", ITERATIONS, "iteration");
+
+    debug.SetFlags(oldFlags);
+}
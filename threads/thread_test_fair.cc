@@ -0,0 +1,105 @@
+/// Test of the shares of the CPU given by the fair-share policy.
+///
+/// Runs threads of different priorities that compute without pause for the
+/// same stretch of time, first with static priorities and then with fair
+/// shares, and prints the CPU time each one got against the share its
+/// priority entitles it to.  Checks that with static priorities the
+/// threads of the highest priority take all the CPU, and that with fair
+/// shares each thread gets its own share, give or take `TOLERANCE`.
+///
+/// Needs the timer, so Nachos must run with `-ts` or `-fair`.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "thread_test_fair.hh"
+#include "system.hh"
+
+#include <stdio.h>
+
+
+static const int PRIORITIES[] = { 0, 1, 3, 3 };
+static const unsigned NUM_THREADS = sizeof PRIORITIES / sizeof PRIORITIES[0];
+
+/// Ticks the threads compete for.
+static const unsigned long WINDOW = 40000;
+
+/// Points of the CPU percentage a thread may be off its fair share.
+static const double TOLERANCE = 2.0;
+
+static unsigned long end;
+
+/// CPU time of each thread when the window ended.
+static unsigned long ticks[NUM_THREADS];
+
+static void
+Compute(void *arg)
+{
+    unsigned *i = (unsigned *) arg;
+    while (stats->totalTicks < end) {
+        interrupt->SetLevel(INT_OFF);
+        interrupt->SetLevel(INT_ON);
+    }
+    ticks[*i] = currentThread->GetCpuTicks();
+}
+
+/// Run the threads, with fair shares if `fair`, and check the shares of
+/// the CPU they got.
+static void
+Run(const char *title, bool fair)
+{
+    end = stats->totalTicks + WINDOW;
+
+    Thread *threads[NUM_THREADS];
+    unsigned indices[NUM_THREADS];
+    for (unsigned i = 0; i < NUM_THREADS; i++) {
+        indices[i] = i;
+        threads[i] = new Thread("compute", true, PRIORITIES[i]);
+        threads[i]->Fork(Compute, &indices[i]);
+    }
+    for (unsigned i = 0; i < NUM_THREADS; i++) {
+        threads[i]->Join();
+    }
+
+    unsigned long total = 0;
+    unsigned weights = 0;
+    int highest = 0;
+    for (unsigned i = 0; i < NUM_THREADS; i++) {
+        total += ticks[i];
+        weights += PRIORITIES[i] + 1;
+        if (PRIORITIES[i] > highest) {
+            highest = PRIORITIES[i];
+        }
+    }
+    printf("%s:\n", title);
+    for (unsigned i = 0; i < NUM_THREADS; i++) {
+        double share = 100.0 * ticks[i] / total;
+        double fairShare = 100.0 * (PRIORITIES[i] + 1) / weights;
+        printf("    priority %d: %6lu ticks, %5.1f%% (fair share %5.1f%%)\n",
+               PRIORITIES[i], ticks[i], share, fairShare);
+        if (fair) {
+            ASSERT(share > fairShare - TOLERANCE
+                     && share < fairShare + TOLERANCE);
+        } else if (PRIORITIES[i] < highest) {
+            ASSERT(share < 1.0);  // Only runs once the window is over.
+        }
+    }
+}
+
+void
+ThreadTestFair()
+{
+    if (timer == nullptr) {
+        printf("This test needs the timer: run Nachos with `-ts` or "
+               "`-fair`.\n");
+        return;
+    }
+
+    scheduler->SetFeedback(0, nullptr, 0);
+    scheduler->SetFairShare(false);
+    Run("Static priorities", false);
+    scheduler->SetFairShare(true);
+    Run("Fair shares", true);
+}
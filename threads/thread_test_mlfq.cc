@@ -0,0 +1,163 @@
+/// Benchmark of the multilevel feedback queues against round robin.
+///
+/// Runs a mix of threads that compute without pause, like `matmult`, and
+/// threads that wait for a key and answer it with a short burst of work,
+/// like `echo`.  Keys are pressed by interrupts scheduled on the simulated
+/// clock, so the run is the same every time.  The mix runs once with
+/// static priorities, where every thread gets the same quantum in turn,
+/// and once with feedback queues, and for each prints the response time of
+/// the echoes, from the key press to the end of the answer, and the
+/// throughput of the computing threads.
+///
+/// Checks that the feedback queues demote the computing threads, that
+/// aging moves waiting threads back up, and that the echoes are answered
+/// sooner than with round robin.
+///
+/// Needs the timer, so Nachos must run with `-ts` or `-mlfq`.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "thread_test_mlfq.hh"
+#include "system.hh"
+#include "semaphore.hh"
+
+#include <stdio.h>
+
+
+static const unsigned NUM_MATMULT = 3;
+static const unsigned NUM_ECHO = 2;
+
+/// Units of work of each computing thread.
+static const unsigned MATMULT_UNITS = 60;
+
+/// Keys pressed to each echo thread, ticks between the answer to a key and
+/// the next press, and interrupt toggles each answer takes.
+static const unsigned KEYS = 10;
+static const unsigned long THINK = 700;
+static const unsigned ECHO_WORK = 3;
+
+/// Feedback queues used for the second run: quanta, in timer interrupts,
+/// from the top level down, and ticks after which waiting threads move up.
+static const unsigned QUANTA[] = { 1, 2, 4, 8 };
+static const unsigned LEVELS = sizeof QUANTA / sizeof QUANTA[0];
+static const unsigned long AGE_TICKS = 1500;
+
+struct Echo {
+    Semaphore *key;
+    unsigned long pressed;  ///< Tick of the last key press.
+};
+
+static unsigned long matmultUnits;
+static unsigned long matmultEnd;
+static unsigned long responses;
+static unsigned long totalResponse;
+static unsigned long maxResponse;
+
+/// Simulate `n` steps of kernel work; each advances the clock by
+/// `SYSTEM_TICK` and gives the timer a chance to interrupt.
+static void
+Work(unsigned n)
+{
+    for (unsigned i = 0; i < n; i++) {
+        interrupt->SetLevel(INT_OFF);
+        interrupt->SetLevel(INT_ON);
+    }
+}
+
+static void
+Matmult(void *)
+{
+    for (unsigned i = 0; i < MATMULT_UNITS; i++) {
+        Work(TIMER_TICKS / SYSTEM_TICK);
+        matmultUnits++;
+    }
+    matmultEnd = stats->totalTicks;
+}
+
+static void
+KeyPressed(void *arg)
+{
+    Echo *e = (Echo *) arg;
+    e->pressed = stats->totalTicks;
+    e->key->V();
+}
+
+static void
+EchoLoop(void *arg)
+{
+    Echo *e = (Echo *) arg;
+    for (unsigned i = 0; i < KEYS; i++) {
+        interrupt->Schedule(KeyPressed, e, THINK, CONSOLE_READ_INT);
+        e->key->P();
+        Work(ECHO_WORK);
+        unsigned long response = stats->totalTicks - e->pressed;
+        responses++;
+        totalResponse += response;
+        if (response > maxResponse) {
+            maxResponse = response;
+        }
+    }
+}
+
+/// Run the mix and return the average response time of the echoes.
+static unsigned long
+Run(const char *title)
+{
+    matmultUnits = matmultEnd = 0;
+    responses = totalResponse = maxResponse = 0;
+    unsigned long start = stats->totalTicks;
+
+    Thread *threads[NUM_MATMULT + NUM_ECHO];
+    Echo echoes[NUM_ECHO];
+    for (unsigned i = 0; i < NUM_MATMULT; i++) {
+        threads[i] = new Thread("matmult", true);
+        threads[i]->Fork(Matmult, nullptr);
+    }
+    for (unsigned i = 0; i < NUM_ECHO; i++) {
+        echoes[i].key = new Semaphore("key", 0);
+        threads[NUM_MATMULT + i] = new Thread("echo", true);
+        threads[NUM_MATMULT + i]->Fork(EchoLoop, &echoes[i]);
+    }
+    for (unsigned i = 0; i < NUM_MATMULT + NUM_ECHO; i++) {
+        threads[i]->Join();
+    }
+    for (unsigned i = 0; i < NUM_ECHO; i++) {
+        delete echoes[i].key;
+    }
+
+    printf("%s:\n", title);
+    printf("    echo response: average %lu ticks, max %lu ticks\n",
+           totalResponse / responses, maxResponse);
+    printf("    matmult throughput: %lu units in %lu ticks, "
+           "%.2f units per 1000 ticks\n", matmultUnits, matmultEnd - start,
+           1000.0 * matmultUnits / (matmultEnd - start));
+    return totalResponse / responses;
+}
+
+void
+ThreadTestMlfq()
+{
+    if (timer == nullptr) {
+        printf("This test needs the timer: run Nachos with `-ts` or "
+               "`-mlfq`.\n");
+        return;
+    }
+
+    scheduler->SetFeedback(0, nullptr, 0);
+    unsigned long roundRobin = Run("Round robin");
+
+    unsigned long demotions = stats->numDemotions;
+    unsigned long promotions = stats->numPromotions;
+    scheduler->SetFeedback(LEVELS, QUANTA, AGE_TICKS);
+    unsigned long feedback = Run("Feedback queues");
+    demotions = stats->numDemotions - demotions;
+    promotions = stats->numPromotions - promotions;
+    printf("    demotions %lu, promotions %lu\n", demotions, promotions);
+
+    ASSERT(demotions > 0);
+    ASSERT(promotions > 0);
+    ASSERT(feedback < roundRobin);
+}
@@ -0,0 +1,184 @@
+/// Test and benchmark of the scheduler with thousands of ready threads.
+///
+/// First checks the order the scheduler promises: a thread of a higher
+/// priority runs before those of lower ones, and threads of the same
+/// priority take turns in the order they became ready.  Then changes the
+/// priority of every thread while all of them are ready, then lets them
+/// take turns calling `Thread::Yield`, and prints the cost of each priority
+/// change and the context switches per second.  For comparison, it also
+/// times the operations of the ready queues made of `List`s that the
+/// scheduler used before: appending (which allocates an element), and
+/// removing a thread from the middle of a queue.
+///
+/// Runs only on a single CPU without the timer, so that threads take turns
+/// just when they yield.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "thread_test_sched.hh"
+#include "thread_test_timing.hh"
+#include "system.hh"
+#include "lib/list.hh"
+
+#include <stdio.h>
+
+
+static const unsigned NUM_THREADS = 2000;
+
+/// Times each thread yields.
+static const unsigned ROUNDS = 100;
+
+/// Times the priority of each thread is changed.
+static const unsigned CHANGES = 100;
+
+static unsigned finished;
+
+static void
+Spin(void *)
+{
+    for (unsigned i = 0; i < ROUNDS; i++) {
+        currentThread->Yield();
+    }
+    finished++;
+}
+
+/// Threads of the same priority in the order check.
+static const unsigned ORDER_THREADS = 8;
+
+/// Times each thread of the order check runs.
+static const unsigned ORDER_ROUNDS = 5;
+
+/// Ids of the threads of the order check, in the order they ran.
+static unsigned order[1 + ORDER_THREADS * ORDER_ROUNDS];
+static unsigned ran;
+
+static void
+Record(void *arg)
+{
+    unsigned id = *(unsigned *) arg;
+    for (unsigned i = 0; i < ORDER_ROUNDS; i++) {
+        order[ran++] = id;
+        currentThread->Yield();
+    }
+}
+
+static void
+RecordOnce(void *arg)
+{
+    order[ran++] = *(unsigned *) arg;
+}
+
+/// Check that the ready thread of the highest priority runs first, and that
+/// threads of the same priority take turns in FIFO order.
+static void
+CheckOrder()
+{
+    static unsigned ids[1 + ORDER_THREADS];
+    for (unsigned i = 0; i < ORDER_THREADS; i++) {
+        ids[i] = i;
+        Thread *t = new Thread("same priority", false, 1);
+        t->Fork(Record, &ids[i]);
+    }
+    // Forked last, but of a higher priority, so it runs first.
+    ids[ORDER_THREADS] = ORDER_THREADS;
+    Thread *urgent = new Thread("higher priority", false, 2);
+    urgent->Fork(RecordOnce, &ids[ORDER_THREADS]);
+
+    // `Yield` hands the CPU over even to a thread of a lower priority, so
+    // this one may run again before the others are done.
+    ran = 0;
+    while (ran < 1 + ORDER_THREADS * ORDER_ROUNDS) {
+        currentThread->Yield();
+    }
+
+    ASSERT(order[0] == ORDER_THREADS);
+    for (unsigned k = 0; k < ORDER_THREADS * ORDER_ROUNDS; k++) {
+        ASSERT(order[1 + k] == k % ORDER_THREADS);
+    }
+    printf("Threads ran by priority, and in FIFO order within one.\n");
+}
+
+/// Time the queue operations of the old scheduler on `threads`.
+static void
+TimeLists(Thread **threads)
+{
+    List<Thread *> *queue = new List<Thread *>;
+
+    Stopwatch watch;
+    for (unsigned r = 0; r < CHANGES; r++) {
+        for (unsigned i = 0; i < NUM_THREADS; i++) {
+            queue->Append(threads[i]);
+        }
+        for (unsigned i = 0; i < NUM_THREADS; i++) {
+            queue->Pop();
+        }
+    }
+    watch.Report("List append and pop (old queues):",
+                 2ul * CHANGES * NUM_THREADS);
+
+    // Moving threads from the middle of a full queue, as the old
+    // `ChangePriority` did.
+    for (unsigned i = 0; i < NUM_THREADS; i++) {
+        queue->Append(threads[i]);
+    }
+    watch.Restart();
+    for (unsigned i = 0; i < NUM_THREADS; i++) {
+        Thread *t = threads[(i * 7919) % NUM_THREADS];
+        queue->Remove(t);
+        queue->Append(t);
+    }
+    watch.Report("List remove and append (old change):", NUM_THREADS);
+    while (!queue->IsEmpty()) {
+        queue->Pop();
+    }
+    delete queue;
+}
+
+void
+ThreadTestSched()
+{
+    // A time slice, or another CPU, could run a thread out of turn.
+    if (timer != nullptr || stats->numCpus > 1) {
+        printf("This test needs a single CPU and no timer: run Nachos "
+               "without `-rs`, `-ts` or `-smp`.\n");
+        return;
+    }
+
+    CheckOrder();
+
+    Thread **threads = new Thread * [NUM_THREADS];
+    for (unsigned i = 0; i < NUM_THREADS; i++) {
+        threads[i] = new Thread("spinner", false, 1);
+        threads[i]->Fork(Spin, nullptr);
+    }
+    printf("%u ready threads, %u priorities.\n", NUM_THREADS, NUM_COLAS);
+
+    TimeLists(threads);
+
+    // Every thread is ready: each change moves it between queues.
+    Stopwatch watch;
+    for (unsigned r = 0; r < CHANGES; r++) {
+        for (unsigned i = 0; i < NUM_THREADS; i++) {
+            threads[i]->ChangePriority(1 + (i + r) % (NUM_COLAS - 1));
+        }
+    }
+    watch.Report("Priority change:", (unsigned long) CHANGES * NUM_THREADS);
+    for (unsigned i = 0; i < NUM_THREADS; i++) {
+        threads[i]->ChangePriority(1);
+    }
+    delete [] threads;  // They are deleted when they finish.
+
+    // This thread has the lowest priority, so it only runs again once all
+    // the others have finished.
+    finished = 0;
+    watch.Restart();
+    currentThread->Yield();
+    ASSERT(finished == NUM_THREADS);
+
+    unsigned long switches = (unsigned long) NUM_THREADS * (ROUNDS + 1);
+    double seconds = watch.Report("Context switch:", switches);
+    printf("%-40s %9.0f per second\n", "Context switches:", switches / seconds);
+}
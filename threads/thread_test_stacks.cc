@@ -0,0 +1,129 @@
+/// Test and benchmark of thread creation with pooled stacks.
+///
+/// First checks that a pool keeps no more idle stacks than its bound.  Then
+/// creates waves of short-lived threads, joining each wave before starting
+/// the next, and prints the cost of creating, running and destroying each
+/// thread, and how many stacks were allocated for all of them.  For
+/// comparison, it also times allocating and freeing a stack directly, as
+/// every `Fork` did before stacks were pooled.  Checks that each thread
+/// took one stack, and that no more stacks were allocated than threads
+/// were alive at once, give or take `SLACK`.
+///
+/// It needs random time slices (`-rs`), so that threads finish before,
+/// while and after they are joined, and the stack of a thread is only
+/// reused once its joiner is done with it.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "thread_test_stacks.hh"
+#include "thread_test_timing.hh"
+#include "system.hh"
+
+#include <stdio.h>
+
+
+static const unsigned WAVES = 100;
+static const unsigned THREADS_PER_WAVE = 100;
+
+/// Stacks allocated beyond one per thread of a wave: a finished thread
+/// keeps its stack until the next one runs.
+static const unsigned SLACK = 2;
+
+/// Stacks taken from and given back to the pool of the bound check, and
+/// the idle stacks it keeps.
+static const unsigned POOL_STACKS = 10;
+static const unsigned POOL_IDLE = 4;
+
+static unsigned finished;
+
+static void
+Nothing(void *)
+{
+    finished++;
+}
+
+/// Check that a pool frees the stacks given back beyond its bound, and
+/// reuses the ones it keeps.
+static void
+CheckPool()
+{
+    StackPool pool(stackPool->GetWords(), 0, POOL_IDLE);
+    uintptr_t *stacks[POOL_STACKS];
+
+    unsigned long allocated = stats->allocatedStacks;
+    unsigned long reused = stats->reusedStacks;
+    for (unsigned i = 0; i < POOL_STACKS; i++) {
+        stacks[i] = pool.Get();
+        stacks[i][0] = STACK_FENCEPOST;
+    }
+    ASSERT(stats->allocatedStacks - allocated == POOL_STACKS);
+    for (unsigned i = 0; i < POOL_STACKS; i++) {
+        pool.Put(stacks[i]);
+    }
+    ASSERT(pool.CountIdle() == POOL_IDLE);
+
+    for (unsigned i = 0; i < POOL_STACKS; i++) {
+        stacks[i] = pool.Get();
+        stacks[i][0] = STACK_FENCEPOST;
+    }
+    ASSERT(stats->reusedStacks - reused == POOL_IDLE);
+    ASSERT(pool.CountIdle() == 0);
+    for (unsigned i = 0; i < POOL_STACKS; i++) {
+        pool.Put(stacks[i]);
+    }
+    ASSERT(pool.CountIdle() == POOL_IDLE);
+}
+
+void
+ThreadTestStacks()
+{
+    if (timer == nullptr) {
+        printf("This test needs random time slices: run Nachos with "
+               "`-rs`.\n");
+        return;
+    }
+
+    CheckPool();
+
+    unsigned long allocated = stats->allocatedStacks;
+    unsigned long reused = stats->reusedStacks;
+    unsigned size = stackPool->GetWords() * sizeof (uintptr_t);
+
+    Stopwatch watch;
+    for (unsigned w = 0; w < WAVES; w++) {
+        char *stacks[THREADS_PER_WAVE];
+        for (unsigned i = 0; i < THREADS_PER_WAVE; i++) {
+            stacks[i] = SystemDep::AllocBoundedArray(size);
+            stacks[i][0] = 0;
+        }
+        for (unsigned i = 0; i < THREADS_PER_WAVE; i++) {
+            SystemDep::DeallocBoundedArray(stacks[i], size);
+        }
+    }
+    watch.Report("Stack allocation (old Fork):", WAVES * THREADS_PER_WAVE,
+                 "stack");
+
+    finished = 0;
+    for (unsigned w = 0; w < WAVES; w++) {
+        Thread *threads[THREADS_PER_WAVE];
+        for (unsigned i = 0; i < THREADS_PER_WAVE; i++) {
+            threads[i] = new Thread("short", true);
+            threads[i]->Fork(Nothing, nullptr);
+        }
+        for (unsigned i = 0; i < THREADS_PER_WAVE; i++) {
+            threads[i]->Join();
+        }
+    }
+    watch.Report("Fork, run and join:", WAVES * THREADS_PER_WAVE, "thread");
+    ASSERT(finished == WAVES * THREADS_PER_WAVE);
+
+    allocated = stats->allocatedStacks - allocated;
+    reused = stats->reusedStacks - reused;
+    printf("%u threads, %u at a time: %lu stacks allocated, %lu reused.\n",
+           WAVES * THREADS_PER_WAVE, THREADS_PER_WAVE, allocated, reused);
+    ASSERT(allocated + reused == WAVES * THREADS_PER_WAVE);
+    ASSERT(allocated <= THREADS_PER_WAVE + SLACK);
+}
@@ -0,0 +1,40 @@
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "thread_test_timing.hh"
+#include "lib/utility.hh"
+
+#include <stdio.h>
+
+
+Stopwatch::Stopwatch()
+{
+    Restart();
+}
+
+void
+Stopwatch::Restart()
+{
+    start = SystemDep::HostTime();
+}
+
+double
+Stopwatch::Seconds() const
+{
+    return SystemDep::HostTime() - start;
+}
+
+double
+Stopwatch::Report(const char *what, unsigned long count, const char *unit)
+{
+    ASSERT(what != nullptr);
+    ASSERT(count > 0);
+    ASSERT(unit != nullptr);
+
+    double seconds = Seconds();
+    printf("%-40s %9.2f ns per %s\n", what, seconds * 1e9 / count, unit);
+    Restart();
+    return seconds;
+}
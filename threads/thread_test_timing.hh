@@ -0,0 +1,39 @@
+/// Host time measurements for the thread tests that are also benchmarks.
+///
+/// What a kernel operation costs is measured in host time, since simulated
+/// ticks are charged at a fixed rate however long the host takes.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_THREADTESTTIMING__HH
+#define NACHOS_THREADS_THREADTESTTIMING__HH
+
+
+class Stopwatch {
+public:
+
+    /// Start timing.
+    Stopwatch();
+
+    /// Start timing again, from now.
+    void Restart();
+
+    /// Return the seconds of host time since timing started.
+    double Seconds() const;
+
+    /// Print `what`, followed by the time each of the `count` operations
+    /// done since timing started took, and start timing again.
+    ///
+    /// `unit` names an operation in the report.  Return the seconds all of
+    /// them took.
+    double Report(const char *what, unsigned long count,
+                  const char *unit = "operation");
+
+private:
+    double start;
+};
+
+
+#endif
@@ -17,14 +17,47 @@
 #define NUM_ROUNDS 4
 #endif
 
+#ifndef DEMAND_LOADING
+/// Return a free frame, taking one from the text cache if there is no other.
+static unsigned
+AllocateFrame()
+{
+    int frame = pagesInUse->Find();
+  #ifdef SHARED_TEXT
+    if (frame == -1) {
+        frame = textCache->Reclaim();
+    }
+  #endif
+    ASSERT(frame != -1);
+    return frame;
+}
+#endif
+
+/// Was the page of `entry` found in the text cache, already loaded?
+static inline bool
+AlreadyLoaded(const TranslationEntry *entry)
+{
+  #ifdef SHARED_TEXT
+    return entry->readOnly && textCache->Holds(entry->physicalPage);
+  #else
+    return false;
+  #endif
+}
+
+AddressSpace::AddressSpace(OpenFile *executable_file, SpaceId id,
+                           const char *name)
+  : AddressSpace(new Executable(executable_file), id, name)
+{}
+
 /// First, set up the translation from program memory to physical memory.
 /// For now, this is really simple (1:1), since we are only uniprogramming,
 /// and we have a single unsegmented page table.
-AddressSpace::AddressSpace(OpenFile *executable_file, SpaceId id)
+AddressSpace::AddressSpace(Executable *executable, SpaceId id,
+                           const char *name)
 {
-    ASSERT(executable_file != nullptr);
+    ASSERT(executable != nullptr);
 
-    exe = new Executable(executable_file);
+    exe = executable;
     // esto verifica que no estemos tratando de ejecutar un archivo q no sea de Nachos
     ASSERT(exe->CheckMagic());
 
@@ -32,12 +65,137 @@ AddressSpace::AddressSpace(OpenFile *executable_file, SpaceId id)
 
     size = exe->GetSize() + USER_STACK_SIZE;
       // We need to increase the size to leave room for the stack.
-    numPages = DivRoundUp(size, PAGE_SIZE);
-    size = numPages * PAGE_SIZE;
+    numPages = DivRoundUp(size, pageSize);
+    size = numPages * pageSize;
+    asid = id;
+
+    textFirst = textEnd = 0;
+  #ifdef SHARED_TEXT
+    if (name != nullptr) {
+        uint32_t codeStart = exe->GetCodeAddr();
+        uint32_t codeEnd = codeStart + exe->GetCodeSize();
+        textFirst = DivRoundUp(codeStart, pageSize);
+        textEnd = codeEnd / pageSize > textFirst ? codeEnd / pageSize
+                                                 : textFirst;
+    }
+  #endif
+
+    SetUp(name);
+
+    #ifndef DEMAND_LOADING // cargamos solo si no estamos utilizando demand_loading
+    char *mainMemory = machine->GetMMU()->mainMemory;
+
+    // Then, copy in the code and data segments into memory, a run of pages
+    // at a time: pages whose frames follow each other are read at once.
+    // Shared code pages found in the text cache are already loaded.
+    uint32_t codeEnd = exe->GetCodeAddr() + exe->GetCodeSize();
+    uint32_t dataEnd = exe->GetInitDataAddr() + exe->GetInitDataSize();
+    uint32_t imageEnd = exe->GetInitDataSize() > 0 && dataEnd > codeEnd
+                        ? dataEnd : codeEnd;
+    unsigned imagePages = DivRoundUp(imageEnd, pageSize);
+    DEBUG('a', "Initializing code and data segments, size %u\n", imageEnd);
+    for (unsigned vpn = 0; vpn < imagePages; ) {
+        if (AlreadyLoaded(&pageTable[vpn])) {
+            vpn++;
+            continue;
+        }
+        unsigned first = vpn++;
+        while (vpn < imagePages && !AlreadyLoaded(&pageTable[vpn])
+               && pageTable[vpn].physicalPage
+                    == pageTable[vpn - 1].physicalPage + 1) {
+            vpn++;
+        }
+        exe->ReadImage(&mainMemory[pageTable[first].physicalPage * pageSize],
+                       first * pageSize, (vpn - first) * pageSize);
+    }
+
+    #ifdef SHARED_TEXT
+    // Only now that they are loaded can other processes share them.
+    for (unsigned vpn = textFirst; vpn < textEnd; vpn++) {
+        unsigned frame = pageTable[vpn].physicalPage;
+        if (!textCache->Holds(frame)) {
+            textCache->Insert(name, exe, vpn, frame);
+            stats->loadedTextPages++;
+        }
+    }
+    #endif
+    #endif
+}
+
+/// Create an address space with no program, for `WritePage` to fill in.
+AddressSpace::AddressSpace(unsigned pages, SpaceId id)
+{
+    exe = nullptr;
+    numPages = pages;
+    size = numPages * pageSize;
+    asid = id;
+    textFirst = textEnd = 0;
+    SetUp();
+}
+
+/// Copy the address space `parent`, for `Fork`.
+AddressSpace::AddressSpace(AddressSpace *parent, SpaceId id)
+{
+    ASSERT(parent != nullptr);
+
+    exe = nullptr;
+    numPages = parent->numPages;
+    size = parent->size;
+    asid = id;
+
+  #ifdef COPY_ON_WRITE
+    // Map the frames of the parent, read-only in both address spaces, so
+    // that whichever writes to a page first gets a copy of its own.  Code
+    // pages shared through the text cache stay shared for good.
+    textFirst = parent->textFirst;
+    textEnd = parent->textEnd;
+    DEBUG('a', "Forking address space, num pages %u, size %u\n",
+          numPages, size);
+    pageTable = new TranslationEntry[numPages];
+    for (unsigned i = 0; i < numPages; i++) {
+        TranslationEntry *from = &parent->pageTable[i];
+        #ifdef SHARED_TEXT
+        if (IsSharedText(i)) {
+            textCache->Share(from->physicalPage);
+        } else
+        #endif
+        {
+            frameRefs->Share(from->physicalPage);
+            from->readOnly = true;
+        }
+        pageTable[i]      = *from;
+        pageTable[i].use  = false;
+        pageTable[i].asid = asid;
+    }
+    stats->forkedPages += numPages;
 
+    // Translations of the parent cached so far may still allow writing.
+    #ifdef USE_TLB
+    machine->GetMMU()->FlushASID(parent->asid);
+    #else
+    machine->GetMMU()->FlushTranslations();
+    #endif
+  #else
+    // Every page gets a copy of its own, code pages included.
+    textFirst = textEnd = 0;
+    SetUp();
+    char *page = new char [pageSize];
+    for (unsigned vpn = 0; vpn < numPages; vpn++) {
+        parent->ReadPage(vpn, page);
+        WritePage(vpn, page);
+    }
+    delete [] page;
+  #endif
+}
+
+void
+AddressSpace::SetUp(const char *name)
+{
     #ifdef SWAP
     // ver si se copia el nombre del archvivo en nombreSwap
-    sprintf(nombreSwap, "userprog/swap/SWAP.%d", currentThread->Pid);
+    // Named after the address space, not `currentThread`: when a process
+    // starts another one, the thread setting it up is the parent.
+    sprintf(nombreSwap, "userprog/swap/SWAP.%u", asid);
 
     if (!fileSystem->Create(nombreSwap, 0)) {
       DEBUG('e', "Error: Swap file not created.\n");
@@ -47,12 +205,12 @@ AddressSpace::AddressSpace(OpenFile *executable_file, SpaceId id)
       DEBUG('e', "Cannot open swap file!\n");
       ASSERT(false);
     }
-    addressSpaceId = id;
+    addressSpaceId = asid;
     #endif
 
-    // ASSERT(numPages <= NUM_PHYS_PAGES);
+    // ASSERT(numPages <= numPhysPages);
     // ahora nos fijamos paginas libres, puesto algunas pueden estar siendo usadas por otros procesos
-    #ifndef SWAP
+    #if !defined(SWAP) && !defined(SHARED_TEXT)
     ASSERT(numPages <= pagesInUse->CountClear());
     #endif
 
@@ -67,9 +225,15 @@ AddressSpace::AddressSpace(OpenFile *executable_file, SpaceId id)
     for (unsigned i = 0; i < numPages; i++) {
         pageTable[i].virtualPage  = i;
       #ifndef DEMAND_LOADING
-        unsigned FPNumber = pagesInUse->Find();
-        ASSERT(FPNumber >= 0);
-        pageTable[i].physicalPage = FPNumber;
+        // Shared code pages are mapped from the text cache if it has them;
+        // if not, the constructor loads them into a frame of their own.
+        int frame = -1;
+        #ifdef SHARED_TEXT
+        if (IsSharedText(i)) {
+            frame = textCache->Acquire(name, exe, i);
+        }
+        #endif
+        pageTable[i].physicalPage = frame != -1 ? frame : AllocateFrame();
         pageTable[i].valid        = true;
       #else
         pageTable[i].physicalPage = -1;
@@ -77,43 +241,22 @@ AddressSpace::AddressSpace(OpenFile *executable_file, SpaceId id)
       #endif
         pageTable[i].use          = false;
         pageTable[i].dirty        = false;
-        pageTable[i].readOnly     = false;
+        pageTable[i].readOnly     = IsSharedText(i);
+        pageTable[i].asid         = asid;
     }
 
-    #ifndef DEMAND_LOADING // cargamos solo si no estamos utilizando demand_loading
+    #ifndef DEMAND_LOADING
     char *mainMemory = machine->GetMMU()->mainMemory;
     for (unsigned i = 0; i < numPages; i++) {
-        memset(&mainMemory[pageTable[i].physicalPage * PAGE_SIZE], 0, PAGE_SIZE);
-    }
-
-    // Then, copy in the code and data segments into memory.
-    uint32_t codeSize = exe->GetCodeSize();
-    uint32_t initDataSize = exe->GetInitDataSize();
-    if (codeSize > 0) {
-        uint32_t virtualAddr = exe->GetCodeAddr();
-        DEBUG('a', "Initializing code segment, at 0x%X, size %u\n",
-              virtualAddr, codeSize);
-        for (uint32_t i = 0; i < codeSize; i++) {
-            uint32_t frame = pageTable[DivRoundDown(virtualAddr + i, PAGE_SIZE)].physicalPage;
-            uint32_t offset = (virtualAddr + i) % PAGE_SIZE;
-            uint32_t physicalAddr = frame * PAGE_SIZE + offset;
-            exe->ReadCodeBlock(&mainMemory[physicalAddr], 1, i);
-        }
-    }
-    if (initDataSize > 0) {
-        uint32_t virtualAddr = exe->GetInitDataAddr();
-        DEBUG('a', "Initializing data segment, at 0x%X, size %u\n",
-              virtualAddr, initDataSize);
-        // exe.ReadDataBlock(&mainMemory[virtualAddr], initDataSize, 0);
-        for (uint32_t i = 0; i < initDataSize; i++) {
-          uint32_t frame = pageTable[DivRoundDown(virtualAddr + i, PAGE_SIZE)].physicalPage;
-          uint32_t offset = (virtualAddr + i) % PAGE_SIZE;
-          uint32_t physicalAddr = frame * PAGE_SIZE + offset;
-          exe->ReadDataBlock(&mainMemory[physicalAddr], 1, i);
+        if (AlreadyLoaded(&pageTable[i])) {
+            continue;
         }
+        memset(&mainMemory[pageTable[i].physicalPage * pageSize], 0, pageSize);
+        machine->GetMMU()->InvalidateFrame(pageTable[i].physicalPage);
     }
     #endif
 }
+
 /// Deallocate an address space.
 ///
 /// Nothing for now!
@@ -121,10 +264,25 @@ AddressSpace::~AddressSpace()
 { 
   #ifndef SWAP
   for (unsigned i = 0; i < numPages; i++) {
+    #ifdef SHARED_TEXT
+    if (IsSharedText(i)) {
+      textCache->Release(pageTable[i].physicalPage);
+      continue;
+    }
+    #endif
+    #ifdef COPY_ON_WRITE
+    if (!frameRefs->Drop(pageTable[i].physicalPage)) {
+      continue;  // Still mapped by another address space.
+    }
+    #endif
     pagesInUse->Clear(pageTable[i].physicalPage);
   }
   #endif
   delete [] pageTable;
+  delete exe;
+  #ifdef USE_TLB
+  machine->GetMMU()->FlushASID(asid);
+  #endif
   #ifdef SWAP
   fileSystem->Remove(nombreSwap);
   delete swap;
@@ -154,9 +312,9 @@ AddressSpace::InitRegisters()
     // Set the stack register to the end of the address space, where we
     // allocated the stack; but subtract off a bit, to make sure we do not
     // accidentally reference off the end!
-    machine->WriteRegister(STACK_REG, numPages * PAGE_SIZE - 16);
+    machine->WriteRegister(STACK_REG, numPages * pageSize - 16);
     DEBUG('a', "Initializing stack register to %u\n",
-          numPages * PAGE_SIZE - 16);
+          numPages * pageSize - 16);
 }
 
 /// On a context switch, save any machine state, specific to this address
@@ -167,14 +325,15 @@ void
 AddressSpace::SaveState()
 {
   #ifdef SWAP
+  // Entries stay in the TLB, tagged with our identifier; only their use
+  // and dirty bits are saved.
   TranslationEntry *tlb = machine->GetMMU()->tlb;
-  for (unsigned i = 0; i < TLB_SIZE; i++)
+  for (unsigned i = 0; i < machine->GetMMU()->GetTLBSize(); i++)
   {
-    if (tlb[i].valid)
+    if (tlb[i].valid && tlb[i].asid == asid)
     {
       unsigned physicalPageToSave = machine->GetMMU()->tlb[i].physicalPage;
       TranslationEntry* entry = &GetPageTable()[pagesInUse[physicalPageToSave].virtualPage];
-      machine->GetMMU()->tlb[i].valid = false;
       *entry = machine->GetMMU()->tlb[i];
     }
   }
@@ -191,9 +350,22 @@ void AddressSpace::RestoreState()
   machine->GetMMU()->pageTable = pageTable;
   machine->GetMMU()->pageTableSize = numPages;
   #else
-  for (unsigned i = 0; i < TLB_SIZE; i++) {
-    machine->GetMMU()->tlb[i].valid = false;
-  }
+  // No need to flush the TLB: entries of other address spaces do not match.
+  machine->GetMMU()->SetASID(asid);
+  #endif
+  machine->GetMMU()->FlushTranslations();
+}
+
+/// Identifiers and page tables of live address spaces are unique, and every
+/// address space is restored before it first runs, so a match cannot be
+/// left over from an address space that no longer exists.
+bool
+AddressSpace::IsLoaded() const
+{
+  #ifdef USE_TLB
+  return machine->GetMMU()->GetASID() == asid;
+  #else
+  return machine->GetMMU()->pageTable == pageTable;
   #endif
 }
 
@@ -203,50 +375,32 @@ void AddressSpace::LoadPage(unsigned vpn, unsigned phy)
   ASSERT(vpn >= 0);
   ASSERT(phy != INT_MAX); //i  have a valid frame
 
-  uint32_t codeSize = exe->GetCodeSize();
-  uint32_t initDataSize = exe->GetInitDataSize();
-  uint32_t dataVirtualAddr = exe->GetInitDataAddr();
-
   DEBUG('e', "Loading page: physicalPage: %d, vpn: %d\n", phy, vpn);
 
   // Get the physical address to write into
-  uint32_t physicalAddressToWrite = phy * PAGE_SIZE;
+  uint32_t physicalAddressToWrite = phy * pageSize;
 
   // Clean the memory
   char *mainMemory = machine->GetMMU()->mainMemory;
-  memset(&mainMemory[physicalAddressToWrite], 0, PAGE_SIZE);
-
-  vpn = vpn / PAGE_SIZE;
-  unsigned vpnAddressToRead = vpn * PAGE_SIZE;
+  memset(&mainMemory[physicalAddressToWrite], 0, pageSize);
+  machine->GetMMU()->InvalidateFrame(phy);
 
-  unsigned readed = 0; // I need to ensure that i have readed PAGE_SIZE bytes
+  vpn = vpn / pageSize;
+  unsigned vpnAddressToRead = vpn * pageSize;
 
+#ifdef SWAP
   if(pageTable[vpn].dirty) {
-    DEBUG('e',"Reading from swap at position %d...\n", vpn * PAGE_SIZE);
-    swap->ReadAt(&mainMemory[physicalAddressToWrite], PAGE_SIZE, vpn * PAGE_SIZE);
-  } else { //read from the exe file
-    if (codeSize > 0 && vpnAddressToRead < codeSize) {
-      uint32_t toRead = codeSize - vpnAddressToRead < PAGE_SIZE ? codeSize - vpnAddressToRead : PAGE_SIZE;
-
-      exe->ReadCodeBlock(&mainMemory[physicalAddressToWrite], PAGE_SIZE, vpnAddressToRead);
-      readed += toRead; //to check if there is some data left to read
-    }
-
-    if (initDataSize > 0 && vpnAddressToRead + readed < dataVirtualAddr + initDataSize &&
-      readed != PAGE_SIZE) {
-      uint32_t toRead = (dataVirtualAddr + initDataSize) - (vpnAddressToRead + readed) < (PAGE_SIZE - readed) ?
-                              (dataVirtualAddr + initDataSize) - (vpnAddressToRead + readed) : PAGE_SIZE - readed;
-      readed ? //if read any bytes in the code section and i have not completed the PAGE_SIZE
-          exe->ReadDataBlock(&mainMemory[physicalAddressToWrite + readed], toRead,  0) :
-          exe->ReadDataBlock(&mainMemory[physicalAddressToWrite], toRead, vpnAddressToRead - codeSize);
-      readed += toRead;
-    }
+    DEBUG('e',"Reading from swap at position %d...\n", vpn * pageSize);
+    swap->ReadAt(&mainMemory[physicalAddressToWrite], pageSize, vpn * pageSize);
+  } else
+#endif
+  // Spaces resumed from a checkpoint have no executable: all of their
+  // pages come from the swap file.  Stack pages stay zeroed.
+  if (exe != nullptr) {
+    exe->ReadImage(&mainMemory[physicalAddressToWrite], vpnAddressToRead,
+                   pageSize);
   }
 
-  if(vpnAddressToRead > codeSize + initDataSize) { // We are reading from the stack
-    readed = PAGE_SIZE; // memset already done previously
-  };
-
   #ifdef SWAP
 
   CoreMapEntry* chosenCoreMapEntry = &pagesInUse[phy];
@@ -255,9 +409,11 @@ void AddressSpace::LoadPage(unsigned vpn, unsigned phy)
 
   DEBUG('e',"Marking physical page %u, with virtualPage %u from process %d in the coremap\n", phy, vpn, addressSpaceId);
 
-  DEBUG('e',"State of the coremap: \n");
-  for(unsigned i = 0; i < NUM_PHYS_PAGES; i++){
-    DEBUG('e',"Physical page: %u, spaceId: %d, virtualPage of the mentioned process: %u \n", i, pagesInUse[i].spaceId, pagesInUse[i].virtualPage);
+  if (debug.IsEnabled('e')) { // walking the whole coremap is expensive
+    DEBUG('e',"State of the coremap: \n");
+    for(unsigned i = 0; i < numPhysPages; i++){
+      DEBUG('e',"Physical page: %u, spaceId: %d, virtualPage of the mentioned process: %u \n", i, pagesInUse[i].spaceId, pagesInUse[i].virtualPage);
+    }
   }
 #endif
   DEBUG('e', "finished loading page! :) \n");
@@ -265,18 +421,134 @@ void AddressSpace::LoadPage(unsigned vpn, unsigned phy)
 }
 #endif
 
+bool
+AddressSpace::IsSharedText(unsigned vpn) const
+{
+    return textFirst <= vpn && vpn < textEnd;
+}
+
 TranslationEntry *
 AddressSpace::GetPageTable()
 {
     return pageTable;
 }
 
+unsigned
+AddressSpace::GetNumPages() const
+{
+    return numPages;
+}
+
+void
+AddressSpace::ReadPage(unsigned vpn, char *into)
+{
+    ASSERT(vpn < numPages);
+    ASSERT(into != nullptr);
+
+    const TranslationEntry *entry = &pageTable[vpn];
+    if (entry->valid) {
+        const char *mainMemory = machine->GetMMU()->mainMemory;
+        memcpy(into, &mainMemory[entry->physicalPage * pageSize], pageSize);
+        return;
+    }
+
+    memset(into, 0, pageSize);
+  #ifdef SWAP
+    if (entry->dirty) {
+        swap->ReadAt(into, pageSize, vpn * pageSize);
+        return;
+    }
+  #endif
+  #ifdef DEMAND_LOADING
+    // Never loaded: it is still as in the executable.
+    if (exe != nullptr) {
+        exe->ReadImage(into, vpn * pageSize, pageSize);
+    }
+  #endif
+}
+
+void
+AddressSpace::WritePage(unsigned vpn, const char *from)
+{
+    ASSERT(vpn < numPages);
+    ASSERT(from != nullptr);
+
+    TranslationEntry *entry = &pageTable[vpn];
+  #ifdef SWAP
+    if (!entry->valid) {
+        // Leave it in the swap file until it is touched.
+        swap->WriteAt(from, pageSize, vpn * pageSize);
+        entry->dirty = true;
+        return;
+    }
+  #elif defined(DEMAND_LOADING)
+    if (!entry->valid) {
+        int frame = pagesInUse->Find();
+        ASSERT(frame != -1);
+        entry->physicalPage = frame;
+        entry->valid = true;
+    }
+  #endif
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    memcpy(&mainMemory[entry->physicalPage * pageSize], from, pageSize);
+    machine->GetMMU()->InvalidateFrame(entry->physicalPage);
+}
+
+#ifdef COPY_ON_WRITE
+bool
+AddressSpace::CopyOnWrite(unsigned vpn)
+{
+    ASSERT(vpn < numPages);
+
+    TranslationEntry *entry = &pageTable[vpn];
+    if (!entry->readOnly || IsSharedText(vpn)) {
+        return false;
+    }
+
+    // If the others that mapped the frame already made copies of their
+    // own, it is left to this address space and needs no copy either.
+    unsigned frame = entry->physicalPage;
+    if (!frameRefs->Drop(frame)) {
+        char *mainMemory = machine->GetMMU()->mainMemory;
+        unsigned copy = AllocateFrame();
+        memcpy(&mainMemory[copy * pageSize], &mainMemory[frame * pageSize],
+               pageSize);
+        machine->GetMMU()->InvalidateFrame(copy);
+        entry->physicalPage = copy;
+        stats->copiedPages++;
+        DEBUG('a', "Copied page %u from frame %u to %u\n", vpn, frame, copy);
+    }
+    entry->readOnly = false;
+
+    #ifdef USE_TLB
+    machine->GetMMU()->FlushPage(asid, vpn);
+    #else
+    machine->GetMMU()->FlushTranslations();
+    #endif
+    return true;
+}
+#endif
+
 #ifdef PRPOLICY_FIFO
 int nextVictim = 0;
 #endif
 
 #ifdef PRPOLICY_LRU
-int nextVictim = 0;
+/// Frame the clock hand points at.
+static unsigned clockHand = 0;
+
+/// Return the page table entry of the page held in `frame`, or null if the
+/// process it belonged to is gone.
+static TranslationEntry *
+FrameEntry(unsigned frame)
+{
+    SpaceId owner = pagesInUse[frame].spaceId;
+    if (!runningProcesses->HasKey(owner)) {
+        return nullptr;
+    }
+    AddressSpace *space = runningProcesses->Get(owner)->space;
+    return &space->GetPageTable()[pagesInUse[frame].virtualPage];
+}
 #endif
 
 #ifdef SWAP
@@ -289,7 +561,7 @@ AddressSpace::EvacuatePage() {
   if(runningProcesses->HasKey(victimSpace)) { // the victim process is alive
       TranslationEntry* entry = &runningProcesses->Get(victimSpace)->space->GetPageTable()[pagesInUse[victim].virtualPage];
 
-    for(unsigned int i = 0; i < TLB_SIZE; ++i) { // save the bits if the page is in the TLB
+    for(unsigned int i = 0; i < machine->GetMMU()->GetTLBSize(); ++i) { // save the bits if the page is in the TLB
       if(machine->GetMMU()->tlb[i].physicalPage == victim && machine->GetMMU()->tlb[i].valid) {
         machine->GetMMU()->tlb[i].valid = false;
         *entry = machine->GetMMU()->tlb[i];
@@ -300,14 +572,15 @@ AddressSpace::EvacuatePage() {
     DEBUG('e', "In evacuate page, the entry is: \n dirty: %d\n valid: %d\n", entry->dirty, entry->valid);
     if(entry->dirty) {
       char *mainMemory = machine->GetMMU()->mainMemory;
-      unsigned physicalAddressToWrite = victim * PAGE_SIZE;
+      unsigned physicalAddressToWrite = victim * pageSize;
       DEBUG('e',"Writing into swap...\n");
-      runningProcesses->Get(pagesInUse[victim].spaceId)->space->swap->WriteAt(&mainMemory[physicalAddressToWrite], PAGE_SIZE, pagesInUse[victim].virtualPage * PAGE_SIZE);   //save the evacuated information in the N file block
+      runningProcesses->Get(pagesInUse[victim].spaceId)->space->swap->WriteAt(&mainMemory[physicalAddressToWrite], pageSize, pagesInUse[victim].virtualPage * pageSize);   //save the evacuated information in the N file block
     }
 
       entry->physicalPage = INT_MAX; // mark the entry out of the memory for the pageTable
       entry->valid = false; // mark the entry out of the memory for the machine
   }
+  machine->GetMMU()->InvalidateFrame(victim); // the frame is about to hold another page
   return victim;
 }
 #endif
@@ -319,29 +592,40 @@ PickVictim()
   
   // politica fifo
   int i = nextVictim;
-  nextVictim++ % NUM_PHYS_PAGES;
+  nextVictim = (nextVictim + 1) % numPhysPages;
   return i;
   #endif
   #ifdef PRPOLICY_LRU
-  int victim;
-  if(references_done == UINT_MAX) {
-    references_done = 0;
-    for(unsigned i = 0; i < NUM_PHYS_PAGES; i++)
-      pagesInUse[i].last_use_counter = 0;
+  // Approximate LRU with a clock: the hand sweeps the coremap, taking the
+  // first frame whose page was not used since the hand last passed it, and
+  // clearing the use bit of those that were.  So an eviction costs O(1)
+  // frames on average, however many there are.
+  #ifdef USE_TLB
+  // The use bits of pages in the TLB are only up to date there.
+  MMU *mmu = machine->GetMMU();
+  for (unsigned i = 0; i < mmu->GetTLBSize(); i++) {
+      TranslationEntry *cached = &mmu->tlb[i];
+      if (cached->valid && cached->use
+            && runningProcesses->HasKey(cached->asid)) {
+          AddressSpace *space = runningProcesses->Get(cached->asid)->space;
+          space->GetPageTable()[cached->virtualPage].use = true;
+          cached->use = false;
+      }
   }
-
-  unsigned min = UINT_MAX;
-  for(unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
-      if(pagesInUse[i].last_use_counter < min) {
-          min = pagesInUse[i].last_use_counter;
-          victim = i;
+  #endif
+  for (;;) {
+      unsigned frame = clockHand;
+      clockHand = (clockHand + 1) % numPhysPages;
+      TranslationEntry *entry = FrameEntry(frame);
+      if (entry == nullptr || !entry->use) {
+          return frame;
       }
+      entry->use = false;  // Second chance.
   }
-  return victim;
   #endif
   #ifdef PRPOLICY_RANDOM
   // politica aleatoria, por default
-  return rand() % NUM_PHYS_PAGES;
+  return rand() % numPhysPages;
   #endif
   return 0;
 }
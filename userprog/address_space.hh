@@ -35,8 +35,34 @@ public:
     ///
     /// Parameters:
     /// * `executable_file` is the open file that corresponds to the
-    ///   program; it contains the object code to load into memory.
-    AddressSpace(OpenFile *executable_file, SpaceId id);
+    ///   program; it contains the object code to load into memory.  It is
+    ///   then owned by the address space, as its `Executable` reads from
+    ///   it for as long as the space exists.
+    /// * `name` is the name the file was opened with.  With *SHARED_TEXT*,
+    ///   pages holding only code are shared read-only with other address
+    ///   spaces running the file of the same name (see `text_cache.hh`);
+    ///   if null, every page is private.
+    AddressSpace(OpenFile *executable_file, SpaceId id,
+                 const char *name = nullptr);
+
+    /// Create an address space to run the program `executable`, which is
+    /// then owned by the address space; otherwise like the above.
+    AddressSpace(Executable *executable, SpaceId id,
+                 const char *name = nullptr);
+
+    /// Create an address space of `pages` pages, with no program in it.
+    ///
+    /// Its contents are to be set with `WritePage`, as when resuming a
+    /// process from a checkpoint.
+    AddressSpace(unsigned pages, SpaceId id);
+
+    /// Create a copy of the address space `parent`, for a process started
+    /// by `Fork`.
+    ///
+    /// With *COPY_ON_WRITE*, no memory is copied: both address spaces map
+    /// the frames of `parent` read-only, and pages are copied when first
+    /// written to (see `CopyOnWrite`).  Otherwise every page is copied now.
+    AddressSpace(AddressSpace *parent, SpaceId id);
 
     /// De-allocate an address space.
     ~AddressSpace();
@@ -48,7 +74,31 @@ public:
 
     void SaveState();
     void RestoreState();
+
+    /// Is the MMU of the current CPU already set up to translate for this
+    /// address space, so that `RestoreState` would change nothing?
+    bool IsLoaded() const;
     TranslationEntry *GetPageTable();
+
+    unsigned GetNumPages() const;
+
+    /// Copy the current contents of the virtual page `vpn` into `into`,
+    /// whether the page is in memory, in the swap file, or has yet to be
+    /// loaded from the executable.
+    void ReadPage(unsigned vpn, char *into);
+
+    /// Set the contents of the virtual page `vpn`.
+    void WritePage(unsigned vpn, const char *from);
+
+  #ifdef COPY_ON_WRITE
+    /// Handle a write to the read-only virtual page `vpn`.
+    ///
+    /// If the page is shared with another address space since a `Fork`,
+    /// give it a frame of its own (or keep the frame, if no other address
+    /// space maps it any more) and make it writable.  Return false if the
+    /// page is really read-only, such as a shared code page.
+    bool CopyOnWrite(unsigned vpn);
+  #endif
     #ifdef DEMAND_LOADING
 
     // Loads a page to memory
@@ -63,14 +113,32 @@ public:
     #endif
 private:
 
+    /// Allocate the page table (and the swap file, or the frames), once
+    /// the size of the address space is known.
+    ///
+    /// With *SHARED_TEXT*, the frames of the code pages of the file `name`
+    /// are taken from the text cache when it has them.
+    void SetUp(const char *name = nullptr);
+
+    /// Is page `vpn` one of the code pages shared through the text cache?
+    bool IsSharedText(unsigned vpn) const;
+
     /// Assume linear page table translation for now!
     TranslationEntry *pageTable;
 
     /// Number of pages in the virtual address space.
     unsigned numPages;
 
+    /// Identifier of the address space, tagged on its TLB entries.
+    unsigned asid;
+
     Executable *exe;
 
+    /// Pages holding only code, from `textFirst` up to (but not including)
+    /// `textEnd`; with *SHARED_TEXT* they are mapped read-only.
+    unsigned textFirst;
+    unsigned textEnd;
+
     unsigned int size;
 };
 
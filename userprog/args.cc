@@ -86,7 +86,8 @@ WriteArgs(char **args)
             break;
         }
         sp -= strlen(args[c]) + 1;  // Decrease SP (leave one byte for \0).
-        WriteStringToUser(args[c], sp);  // Write the string there.
+        bool ok = WriteStringToUser(args[c], sp);  // Write the string there.
+        ASSERT(ok);                 // The new stack is always writable.
         argsAddress[c] = sp;        // Save the argument's address.
         delete args[c];             // Free the string.
     }
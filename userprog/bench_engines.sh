@@ -0,0 +1,20 @@
+#!/bin/bash
+# Run user programs once with each execution engine and report the
+# simulated MIPS of both, as printed by `Statistics::Print`.
+#
+# Usage: bench_engines.sh [PROGRAM...]   (defaults: matmult sort)
+#
+# Run from the root of the tree, after building `userprog` and `userland`.
+
+NACHOS=${NACHOS:-./userprog/nachos}
+PROGRAMS=${*:-"userland/matmult userland/sort"}
+
+for prog in $PROGRAMS; do
+    for engine in "" "-th"; do
+        if [ -z "$engine" ]; then name=switch; else name=threaded; fi
+        # Keep standard input open so that the console does not halt early.
+        speed=$($NACHOS $engine -x "$prog" < <(sleep 1) 2>&1 \
+                | grep "Simulation speed" | sed 's/^Simulation speed: //')
+        printf "%-24s %-9s %s\n" "$(basename "$prog")" "$name" "$speed"
+    done
+done
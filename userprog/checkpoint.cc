@@ -0,0 +1,268 @@
+/// Routines to write checkpoints of user programs, and resume them.
+///
+/// A checkpoint file holds, in this order: a `CheckpointHeader`, the
+/// counters of `stats` listed by `GetCounters`, the user registers, every
+/// page of the address space, and the disk image (if any).
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "checkpoint.hh"
+#include "address_space.hh"
+#include "threads/system.hh"
+#include "machine/system_dep.hh"
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+static const uint32_t CHECKPOINT_MAGIC   = 0x504B434E;  // "NCKP".
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+/// Ticks to wait before trying again, when the process is not in user mode
+/// at the tick of the checkpoint.
+static const unsigned long CHECKPOINT_RETRY = 10;
+
+/// The disk image, as named by `Initialize`.
+static const char DISK_IMAGE[] = "DISK";
+
+struct CheckpointHeader {
+    uint32_t magic;         ///< Should be `CHECKPOINT_MAGIC`.
+    uint32_t version;       ///< Should be `CHECKPOINT_VERSION`.
+    uint32_t pageSize;      ///< Memory layout of the machine.
+    uint32_t numPhysPages;
+    uint32_t numPages;      ///< Pages of the address space.
+    uint32_t numCounters;   ///< Counters of `stats`.
+    uint32_t diskSize;      ///< Bytes of the disk image, or 0 if none.
+};
+
+static const unsigned MAX_COUNTERS = 32;
+
+/// Gather the counters of `stats` that are saved in a checkpoint, which
+/// depend on the build configuration.  Return how many there are.
+static unsigned
+GetCounters(unsigned long **counters)
+{
+    ASSERT(counters != nullptr);
+
+    unsigned n = 0;
+    counters[n++] = &stats->totalTicks;
+    counters[n++] = &stats->idleTicks;
+    counters[n++] = &stats->systemTicks;
+    counters[n++] = &stats->userTicks;
+    counters[n++] = &stats->numDiskReads;
+    counters[n++] = &stats->numDiskWrites;
+    counters[n++] = &stats->numConsoleCharsRead;
+    counters[n++] = &stats->numConsoleCharsWritten;
+    counters[n++] = &stats->numPageFaults;
+    counters[n++] = &stats->numPacketsSent;
+    counters[n++] = &stats->numPacketsRecvd;
+#ifdef USE_TLB
+    counters[n++] = &stats->accessTable;
+    counters[n++] = &stats->hits;
+    counters[n++] = &stats->tlbMissesAvoided;
+#endif
+#ifdef SWAP
+    counters[n++] = &stats->toSwap;
+    counters[n++] = &stats->fromSwap;
+#endif
+#ifdef DFS_TICKS_FIX
+    counters[n++] = &stats->tickResets;
+#endif
+    ASSERT(n <= MAX_COUNTERS);
+    return n;
+}
+
+/// Read the header of the checkpoint open as `file`, and check that it can
+/// be resumed by this kernel.
+static bool
+ReadHeader(int file, CheckpointHeader *h)
+{
+    ASSERT(h != nullptr);
+
+    unsigned long *counters[MAX_COUNTERS];
+    return SystemDep::ReadPartial(file, (char *) h, sizeof *h)
+             == (int) sizeof *h
+           && h->magic == CHECKPOINT_MAGIC
+           && h->version == CHECKPOINT_VERSION
+           && h->pageSize == pageSize
+           && h->numPhysPages == numPhysPages
+           && h->numCounters == GetCounters(counters);
+}
+
+static void
+WriteCheckpoint(const char *fileName)
+{
+    ASSERT(fileName != nullptr);
+
+    AddressSpace *space = currentThread->space;
+    unsigned long *counters[MAX_COUNTERS];
+    CheckpointHeader h;
+    h.magic        = CHECKPOINT_MAGIC;
+    h.version      = CHECKPOINT_VERSION;
+    h.pageSize     = pageSize;
+    h.numPhysPages = numPhysPages;
+    h.numPages     = space->GetNumPages();
+    h.numCounters  = GetCounters(counters);
+    h.diskSize     = 0;
+
+    char *disk = nullptr;
+#ifdef FILESYS
+    int diskFile = SystemDep::OpenForReadWrite(DISK_IMAGE, false);
+    if (diskFile >= 0) {
+        SystemDep::Lseek(diskFile, 0, SEEK_END);
+        h.diskSize = SystemDep::Tell(diskFile);
+        SystemDep::Lseek(diskFile, 0, SEEK_SET);
+        disk = new char [h.diskSize];
+        SystemDep::Read(diskFile, disk, h.diskSize);
+        SystemDep::Close(diskFile);
+    }
+#endif
+
+    int file = SystemDep::OpenForWrite(fileName);
+    SystemDep::WriteFile(file, (const char *) &h, sizeof h);
+    for (unsigned i = 0; i < h.numCounters; i++) {
+        SystemDep::WriteFile(file, (const char *) counters[i],
+                             sizeof *counters[i]);
+    }
+
+    int registers[NUM_TOTAL_REGS];
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        registers[i] = machine->ReadRegister(i);
+    }
+    SystemDep::WriteFile(file, (const char *) registers, sizeof registers);
+
+    char *page = new char [pageSize];
+    for (unsigned vpn = 0; vpn < h.numPages; vpn++) {
+        space->ReadPage(vpn, page);
+        SystemDep::WriteFile(file, page, pageSize);
+    }
+    delete [] page;
+
+    if (disk != nullptr) {
+        SystemDep::WriteFile(file, disk, h.diskSize);
+        delete [] disk;
+    }
+    SystemDep::Close(file);
+
+    printf("Checkpoint written to %s at tick %lu.\n",
+           fileName, stats->totalTicks);
+}
+
+/// Take the checkpoint asked for by `ScheduleCheckpoint`.
+///
+/// The registers of a process are only all in the machine while it runs in
+/// user mode, so the checkpoint waits for it if the kernel is running.
+static void
+CheckpointHandler(void *fileName)
+{
+    if (interrupt->GetInterruptedStatus() != USER_MODE) {
+        if (runningProcesses->IsEmpty()) {
+            printf("Checkpoint not written: no process is running.\n");
+        } else {
+            interrupt->Schedule(CheckpointHandler, fileName,
+                                CHECKPOINT_RETRY, CHECKPOINT_INT);
+        }
+        return;
+    }
+
+    unsigned processes = 0;
+    for (unsigned i = 0; i < Table<Thread *>::SIZE; i++) {
+        if (runningProcesses->HasKey(i)) {
+            processes++;
+        }
+    }
+    if (processes != 1) {
+        printf("Checkpoint not written: %u processes are running.\n",
+               processes);
+        return;
+    }
+    WriteCheckpoint((const char *) fileName);
+}
+
+void
+ScheduleCheckpoint(const char *fileName, unsigned long when)
+{
+    ASSERT(fileName != nullptr);
+    ASSERT(when > stats->totalTicks);
+
+    interrupt->Schedule(CheckpointHandler, (void *) fileName,
+                        when - stats->totalTicks, CHECKPOINT_INT);
+}
+
+void
+RestoreDiskImage(const char *fileName)
+{
+    ASSERT(fileName != nullptr);
+
+    int file = SystemDep::OpenForReadWrite(fileName, false);
+    CheckpointHeader h;
+    if (file < 0 || !ReadHeader(file, &h)) {
+        if (file >= 0) {
+            SystemDep::Close(file);
+        }
+        return;  // `ResumeProcess` will complain.
+    }
+    if (h.diskSize > 0) {
+        unsigned offset = sizeof h + h.numCounters * sizeof (unsigned long)
+                          + NUM_TOTAL_REGS * sizeof (int)
+                          + h.numPages * pageSize;
+        SystemDep::Lseek(file, offset, SEEK_SET);
+        char *disk = new char [h.diskSize];
+        SystemDep::Read(file, disk, h.diskSize);
+        int diskFile = SystemDep::OpenForWrite(DISK_IMAGE);
+        SystemDep::WriteFile(diskFile, disk, h.diskSize);
+        SystemDep::Close(diskFile);
+        delete [] disk;
+    }
+    SystemDep::Close(file);
+}
+
+void
+ResumeProcess(const char *fileName)
+{
+    ASSERT(fileName != nullptr);
+
+    int file = SystemDep::OpenForReadWrite(fileName, false);
+    if (file < 0) {
+        printf("Unable to open checkpoint %s\n", fileName);
+        return;
+    }
+    CheckpointHeader h;
+    if (!ReadHeader(file, &h)) {
+        printf("%s is not a checkpoint that this kernel can resume\n",
+               fileName);
+        SystemDep::Close(file);
+        return;
+    }
+
+    unsigned long *counters[MAX_COUNTERS];
+    GetCounters(counters);
+    for (unsigned i = 0; i < h.numCounters; i++) {
+        SystemDep::Read(file, (char *) counters[i], sizeof *counters[i]);
+    }
+    int registers[NUM_TOTAL_REGS];
+    SystemDep::Read(file, (char *) registers, sizeof registers);
+
+    SpaceId spaceId = (SpaceId) runningProcesses->Add(currentThread);
+    AddressSpace *space = new AddressSpace(h.numPages, spaceId);
+    currentThread->space = space;
+
+    char *page = new char [pageSize];
+    for (unsigned vpn = 0; vpn < h.numPages; vpn++) {
+        SystemDep::Read(file, page, pageSize);
+        space->WritePage(vpn, page);
+    }
+    delete [] page;
+    SystemDep::Close(file);
+
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        machine->WriteRegister(i, registers[i]);
+    }
+    space->RestoreState();  // Load page table register.
+
+    machine->Run();  // Jump back into the user progam.
+    ASSERT(false);   // `machine->Run` never returns.
+}
@@ -0,0 +1,39 @@
+/// Checkpoints of a running user program, to resume it in a later run.
+///
+/// A checkpoint is taken at a given tick, from an interrupt, while a single
+/// process runs in user mode.  It holds the statistics (and with them the
+/// simulated clock), the user registers, the contents of every page of the
+/// address space, and, when there is a simulated disk, the disk image.
+/// Resuming builds a new address space from the saved pages and jumps
+/// straight back into the program, instead of booting it from its
+/// executable.
+///
+/// Kernel state that cannot be rebuilt is not saved: other threads, open
+/// files, and pending interrupts, since devices schedule their own anew
+/// when they start.  The file is in the format of the host, and must be
+/// resumed with the same memory layout and build configuration.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_CHECKPOINT__HH
+#define NACHOS_USERPROG_CHECKPOINT__HH
+
+
+/// Write a checkpoint to the file `fileName` when the clock reaches tick
+/// `when`, or as soon after as the running process is in user mode.
+void ScheduleCheckpoint(const char *fileName, unsigned long when);
+
+/// Put back the disk image saved in the checkpoint `fileName`.
+///
+/// Must be called before the disk is started.
+void RestoreDiskImage(const char *fileName);
+
+/// Resume the process saved in the checkpoint `fileName`.
+///
+/// Like `StartProcess`, only returns if the checkpoint cannot be read.
+void ResumeProcess(const char *fileName);
+
+
+#endif
@@ -23,6 +23,7 @@
 
 
 #include <stdio.h>
+#include <limits.h>
 #include <stdlib.h>
 #include "transfer.hh"
 #include "syscall.h"
@@ -103,6 +104,133 @@ StartProcess(void * voidargv)
      ASSERT(false); //   `machine->Run` never returns; the address space
                      //exits by doing the system call `Exit`.
 }
+
+/// Runs the process started by `Fork`, from where its parent called it.
+///
+/// The user registers were copied from the parent; the child resumes after
+/// the system call, which returns 0 to it.
+static void
+StartForkedProcess(void *)
+{
+    currentThread->RestoreUserState();
+    currentThread->space->RestoreState();  // Load page table register.
+
+    machine->WriteRegister(2, 0);
+    IncrementPC();
+    machine->Run();
+    ASSERT(false);  // `machine->Run` never returns.
+}
+
+/// The `Read` and `Write` system calls move data straight between the
+/// pages of the user buffer and the console or file, a page at a time,
+/// without an intermediate kernel buffer.  Each returns how many bytes were
+/// moved, or -1 if the user buffer could not be accessed at all.
+///
+/// A mapped page stays put only until another thread runs.  Files are safe
+/// to use straight from it, since the stub file system does not block, and
+/// the real one is not built with *SWAP*; the console blocks on every
+/// character, so with *SWAP* it maps each character on its own.
+#ifdef SWAP
+static const unsigned CONSOLE_SPAN = 1;
+#else
+static const unsigned CONSOLE_SPAN = UINT_MAX;
+#endif
+
+static int
+WriteConsoleFromUser(unsigned addr, unsigned size)
+{
+    unsigned done = 0;
+    while (done < size) {
+        char *host;
+        unsigned length, left = size - done;
+        if (!machine->MapSpan(addr + done,
+                              left < CONSOLE_SPAN ? left : CONSOLE_SPAN,
+                              false, &host, &length)) {
+            break;
+        }
+        for (unsigned i = 0; i < length; i++) {
+            synchConsole->WriteChar(host[i]);
+        }
+        done += length;
+    }
+    return done > 0 ? (int) done : -1;
+}
+
+/// Reading from the console stops after a newline, which is stored too.
+static int
+ReadConsoleIntoUser(unsigned addr, unsigned size)
+{
+    unsigned done = 0;
+    bool newline = false;
+    while (done < size && !newline) {
+        char *host;
+        unsigned length, left = size - done;
+        if (!machine->MapSpan(addr + done,
+                              left < CONSOLE_SPAN ? left : CONSOLE_SPAN,
+                              true, &host, &length)) {
+            break;
+        }
+        for (unsigned i = 0; i < length && !newline; i++) {
+            host[i] = synchConsole->ReadChar();
+            newline = host[i] == '\n';
+            done++;
+        }
+    }
+    return done > 0 ? (int) done : -1;
+}
+
+static int
+WriteFileFromUser(OpenFile *file, unsigned addr, unsigned size)
+{
+    ASSERT(file != nullptr);
+
+    unsigned done = 0;
+    while (done < size) {
+        char *host;
+        unsigned length;
+        if (!machine->MapSpan(addr + done, size - done, false,
+                              &host, &length)) {
+            return done > 0 ? (int) done : -1;
+        }
+        int written = file->Write(host, length);
+        if (written > 0) {
+            done += written;
+        }
+        if (written < (int) length) {
+            break;
+        }
+    }
+    return done;
+}
+
+/// When the end of the file comes before the buffer is full, a null is
+/// stored after the bytes read (but not counted), as programs such as `cat`
+/// read until they find one.
+static int
+ReadFileIntoUser(OpenFile *file, unsigned addr, unsigned size)
+{
+    ASSERT(file != nullptr);
+
+    unsigned done = 0;
+    while (done < size) {
+        char *host;
+        unsigned length;
+        if (!machine->MapSpan(addr + done, size - done, true,
+                              &host, &length)) {
+            return done > 0 ? (int) done : -1;
+        }
+        int read = file->Read(host, length);
+        if (read > 0) {
+            done += read;
+        }
+        if (read < (int) length) {
+            host[read > 0 ? read : 0] = '\0';  // End of file.
+            break;
+        }
+    }
+    return done;
+}
+
 // Handle a system call exception.
 
 // * `et` is the kind of exception.  The list of possible exceptions is in
@@ -148,6 +276,12 @@ SyscallHandler(ExceptionType _et)
                   break;
             }
 
+            #ifdef SHARED_TEXT
+            textCache->Forget(filename);  // Its code is about to change.
+            #endif
+            #ifdef EXEC_CACHE
+            imageCache->Forget(filename);
+            #endif
             if (!fileSystem->Create(filename, 100)) {
               DEBUG('e', "File creation failed. \n");
               machine->WriteRegister(2, 1);
@@ -175,6 +309,12 @@ SyscallHandler(ExceptionType _et)
                  break;
              }
 
+             #ifdef SHARED_TEXT
+             textCache->Forget(filename);
+             #endif
+             #ifdef EXEC_CACHE
+             imageCache->Forget(filename);
+             #endif
              if (!fileSystem->Remove(filename)) {
                  DEBUG('e', "File deletion failed. \n");
                  machine->WriteRegister(2, -1);
@@ -205,34 +345,33 @@ SyscallHandler(ExceptionType _et)
                  break;
              }
 
-             char buffer[size+1];
-             ReadBufferFromUser(usrStringAddr, buffer, size);
-             buffer[size] = '\0';
-             int counter = 0;
              if (id == CONSOLE_OUTPUT) {
                  DEBUG('e', "`Write` requested to console output.\n");
-                 ReadBufferFromUser(usrStringAddr, buffer, size);
-                 for (; counter < size; counter++) {
-                     synchConsole->WriteChar(buffer[counter]);
-                 }
-                 machine->WriteRegister(2, counter);
-                 break;
+                 machine->WriteRegister(2, WriteConsoleFromUser(usrStringAddr,
+                                                                size));
              } else {
                  OpenFile* file = currentThread->files->Get(id);
                  if (file != nullptr) {
-                     counter = file->Write(buffer, size);
-                     machine->WriteRegister(2, counter);
-                     break;
+                     #if defined(SHARED_TEXT) || defined(EXEC_CACHE)
+                     // Cached code of the file is about to change.
+                     const char *name = openNames->Find(file);
+                     if (name != nullptr) {
+                         #ifdef SHARED_TEXT
+                         textCache->Forget(name);
+                         #endif
+                         #ifdef EXEC_CACHE
+                         imageCache->Forget(name);
+                         #endif
+                     }
+                     #endif
+                     machine->WriteRegister(2, WriteFileFromUser(file,
+                                                                 usrStringAddr,
+                                                                 size));
                  } else {
                      DEBUG('e', "No matching file with id %d\n", id);
                      machine->WriteRegister(2, -1);
-                     break;
                  }
              }
-             if (counter == size)
-                    machine->WriteRegister(2, 0);
-             else
-                  machine->WriteRegister(2, -1);
              break;
          }
 
@@ -256,38 +395,22 @@ SyscallHandler(ExceptionType _et)
                 break;
             }
 
-            char buffer[size+1];
-            int counter = 0;
-
             if (id == CONSOLE_INPUT) {
                 DEBUG('e', "`Read` requested from console input.\n");
-                for (;counter < size; counter++) {
-                    char c = synchConsole->ReadChar();
-                    if (c == '\n') {
-                        break;
-                    }
-                    buffer[counter] = c;
-                }
-                buffer[counter] = '\n';
-                WriteStringToUser(buffer, usrStringAddr);
-                machine->WriteRegister(2, counter);
-                break;
+                machine->WriteRegister(2, ReadConsoleIntoUser(usrStringAddr,
+                                                              size));
             } else {
                 DEBUG('e', "`Read` requested from file with id %u.\n", id);
                 OpenFile* file = currentThread->files->Get(id);
                 if (file != nullptr) {
-                    counter = file->Read(buffer, size);
-                    buffer[counter] = '\0';
-                    WriteStringToUser(buffer, usrStringAddr);
-                    machine->WriteRegister(2, counter);
-                    break;
+                    machine->WriteRegister(2, ReadFileIntoUser(file,
+                                                               usrStringAddr,
+                                                               size));
                 } else {
                     DEBUG('e', "No matching file with id %d\n", id);
                     machine->WriteRegister(2, -1);
-                    break;
                 }
             }
-
             break;
         }
 
@@ -333,6 +456,9 @@ SyscallHandler(ExceptionType _et)
                 machine->WriteRegister(2, -1);
                 break;
             }
+            #if defined(SHARED_TEXT) || defined(EXEC_CACHE)
+            openNames->Opened(file, buffer);
+            #endif
 
             machine->WriteRegister(2, openFileId);
             break;
@@ -351,6 +477,9 @@ SyscallHandler(ExceptionType _et)
             OpenFile *file = currentThread->files->Remove(fid);
 
             if (file != nullptr) {
+                #if defined(SHARED_TEXT) || defined(EXEC_CACHE)
+                openNames->Closed(file);
+                #endif
                 delete file;
                 machine->WriteRegister(2, 0);
             } else {
@@ -407,7 +536,11 @@ SyscallHandler(ExceptionType _et)
                  argv = SaveArgs(argvAddr);
             }
 
+            #ifdef EXEC_CACHE
+            Executable *executable = imageCache->Open(buffer);
+            #else
             OpenFile *executable = fileSystem->Open(buffer);
+            #endif
 
             if (executable == nullptr) {
                 DEBUG('e', "Unable to open file %s\n", buffer);
@@ -424,17 +557,32 @@ SyscallHandler(ExceptionType _et)
             newThread->Pid = id;
 
             // cargamos el programa a memoria
-            AddressSpace *space = new AddressSpace(executable, id);
+            AddressSpace *space = new AddressSpace(executable, id, buffer);
             newThread->space = space;
 
-            delete executable;
-
             //ejecutamos el proceso
             newThread->Fork(StartProcess, (void *) argv);
             machine->WriteRegister(2, id);
             break;
         }
 
+        case SC_FORK: {
+            bool joinable = machine->ReadRegister(4);
+
+            Thread *newThread = new Thread(currentThread->GetName(), joinable,
+                                           currentThread->GetPriority());
+            SpaceId id = (SpaceId) runningProcesses->Add(newThread);
+            newThread->Pid = id;
+            newThread->space = new AddressSpace(currentThread->space, id);
+
+            // The child starts with the registers of the parent, as they
+            // are at the system call.
+            newThread->SaveUserState();
+            newThread->Fork(StartForkedProcess, nullptr);
+            machine->WriteRegister(2, id);
+            break;
+        }
+
         default:
             fprintf(stderr, "Unexpected system call: id %d.\n", scid);
             ASSERT(false);
@@ -447,7 +595,7 @@ PageFaultHandler(ExceptionType et)
 {
     DEBUG('a', "PageFault");
     int badaddr = machine->ReadRegister(BAD_VADDR_REG);
-    int vpn = badaddr/PAGE_SIZE;
+    int vpn = badaddr/pageSize;
     TranslationEntry fallo = currentThread->space->GetPageTable()[vpn];
     #ifdef DEMAND_LOADING
     if (fallo.physicalPage == -1) {
@@ -455,16 +603,43 @@ PageFaultHandler(ExceptionType et)
     }
     #endif
     #ifdef USE_TLB
+    // Load the translation into the TLB, in the place chosen by the MMU,
+    // keeping the use and dirty bits of the translation it replaces, which
+    // may belong to another address space.
+    TranslationEntry *pageTable = currentThread->space->GetPageTable();
+    if (pageTable[vpn].valid) {
+        TranslationEntry *entry = machine->GetMMU()->PickTLBEntry(vpn);
+        if (entry->valid && runningProcesses->HasKey(entry->asid)) {
+            AddressSpace *owner = runningProcesses->Get(entry->asid)->space;
+            owner->GetPageTable()[entry->virtualPage] = *entry;
+        }
+        *entry = pageTable[vpn];
+    }
     stats->hits-=1;
     #endif
 }
 
+/// Writes to pages shared since a `Fork` copy them.  Any other write to a
+/// read-only page, such as a store into the code, kills the process that
+/// did it; if the kernel was writing on its behalf, the access fails
+/// instead, and the system call returns an error.
 static void
 ReadOnlyHandler(ExceptionType et)
 {
-    DEBUG('e', "Tried to read from a read only page");
-    ASSERT(false); // Esto mata al so
-    return;
+    unsigned badVAddr = machine->ReadRegister(BAD_VADDR_REG);
+  #ifdef COPY_ON_WRITE
+    if (currentThread->space->CopyOnWrite(badVAddr / pageSize)) {
+        return;
+    }
+  #endif
+    if (machine->IsKernelAccess()) {
+        DEBUG('e', "Kernel write to read only address %u refused.\n",
+              badVAddr);
+        return;
+    }
+    fprintf(stderr, "Process killed: write to read only address %u.\n",
+            badVAddr);
+    currentThread->Finish();
 }
 
 /// By default, only system calls have their own handler.  All other
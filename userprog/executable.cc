@@ -7,6 +7,8 @@
 #include "executable.hh"
 #include "machine/endianness.hh"
 
+#include <string.h>
+
 
 /// Do little endian to big endian conversion on the bytes in the object file
 /// header, in case the file was generated on a little endian machine, and we
@@ -28,12 +30,94 @@ SwapHeader(noffHeader *h)
     h->uninitData.inFileAddr  = WordToHost(h->uninitData.inFileAddr);
 }
 
+ExecutableImage::ExecutableImage(OpenFile *file)
+{
+    ASSERT(file != nullptr);
+
+    length = file->Length();
+    contents = new char [length > 0 ? length : 1];
+    if (length > 0) {
+        int got = file->ReadAt(contents, length, 0);
+        length = got > 0 ? got : 0;
+    }
+    holds = 1;
+}
+
+ExecutableImage::~ExecutableImage()
+{
+    delete [] contents;
+}
+
+void
+ExecutableImage::Hold()
+{
+    holds++;
+}
+
+void
+ExecutableImage::Drop()
+{
+    ASSERT(holds > 0);
+
+    if (--holds == 0) {
+        delete this;
+    }
+}
+
+int
+ExecutableImage::ReadAt(char *into, unsigned size, unsigned position) const
+{
+    ASSERT(into != nullptr);
+
+    if (position >= length) {
+        return 0;
+    }
+    if (size > length - position) {
+        size = length - position;
+    }
+    memcpy(into, &contents[position], size);
+    return size;
+}
+
+unsigned
+ExecutableImage::Length() const
+{
+    return length;
+}
+
 Executable::Executable(OpenFile *new_file)
 {
     ASSERT(new_file != nullptr);
 
     file = new_file;
-    file->ReadAt((char *) &header, sizeof header, 0);
+    image = nullptr;
+    ReadAt((char *) &header, sizeof header, 0);
+}
+
+Executable::Executable(ExecutableImage *new_image)
+{
+    ASSERT(new_image != nullptr);
+
+    file = nullptr;
+    image = new_image;
+    image->Hold();
+    memset(&header, 0, sizeof header);
+    ReadAt((char *) &header, sizeof header, 0);
+}
+
+Executable::~Executable()
+{
+    if (image != nullptr) {
+        image->Drop();
+    }
+    delete file;
+}
+
+int
+Executable::ReadAt(char *into, unsigned size, unsigned position)
+{
+    return image != nullptr ? image->ReadAt(into, size, position)
+                            : file->ReadAt(into, size, position);
 }
 
 bool
@@ -82,6 +166,44 @@ Executable::GetInitDataAddr() const
     return header.initData.virtualAddr;
 }
 
+/// Clip the segment `s` to the memory range from `start` to `end`, leaving
+/// the result in `*from` and `*to`.  Return false if they do not overlap.
+static bool
+Clip(const noffSegment &s, uint32_t start, uint32_t end,
+     uint32_t *from, uint32_t *to)
+{
+    *from = s.virtualAddr > start ? s.virtualAddr : start;
+    *to   = s.virtualAddr + s.size < end ? s.virtualAddr + s.size : end;
+    return s.size > 0 && *from < *to;
+}
+
+void
+Executable::ReadImage(char *dest, uint32_t addr, uint32_t size)
+{
+    ASSERT(dest != nullptr);
+
+    const noffSegment &code = header.code, &data = header.initData;
+    uint32_t codeFrom, codeTo, dataFrom, dataTo;
+    bool hasCode = Clip(code, addr, addr + size, &codeFrom, &codeTo);
+    bool hasData = Clip(data, addr, addr + size, &dataFrom, &dataTo);
+
+    if (hasCode && hasData
+          && code.virtualAddr + code.size == data.virtualAddr
+          && code.inFileAddr + code.size == data.inFileAddr) {
+        ReadAt(&dest[codeFrom - addr], dataTo - codeFrom,
+               code.inFileAddr + (codeFrom - code.virtualAddr));
+        return;
+    }
+    if (hasCode) {
+        ReadAt(&dest[codeFrom - addr], codeTo - codeFrom,
+               code.inFileAddr + (codeFrom - code.virtualAddr));
+    }
+    if (hasData) {
+        ReadAt(&dest[dataFrom - addr], dataTo - dataFrom,
+               data.inFileAddr + (dataFrom - data.virtualAddr));
+    }
+}
+
 int
 Executable::ReadCodeBlock(char *dest, uint32_t size, uint32_t offset)
 {
@@ -89,7 +211,7 @@ Executable::ReadCodeBlock(char *dest, uint32_t size, uint32_t offset)
     ASSERT(size != 0);
     ASSERT(offset < header.code.size);
 
-    return file->ReadAt(dest, size, header.code.inFileAddr + offset);
+    return ReadAt(dest, size, header.code.inFileAddr + offset);
 }
 
 int
@@ -99,5 +221,5 @@ Executable::ReadDataBlock(char *dest, uint32_t size, uint32_t offset)
     ASSERT(size != 0);
     ASSERT(offset < header.initData.size);
 
-    return file->ReadAt(dest, size, header.initData.inFileAddr + offset);
+    return ReadAt(dest, size, header.initData.inFileAddr + offset);
 }
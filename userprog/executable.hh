@@ -20,11 +20,52 @@
 #include "filesys/open_file.hh"
 
 
+/// The contents of an executable file, read whole into memory.
+///
+/// Shared by the cache of executables (see `image_cache.hh`) and by every
+/// `Executable` reading from it, so it counts its holders and is deleted
+/// when the last one drops it.
+class ExecutableImage {
+public:
+
+    /// Read the whole of `file`, and hold the result once.
+    ExecutableImage(OpenFile *file);
+
+    /// Take one more hold of the image.
+    void Hold();
+
+    /// Let go of a hold, deleting the image if it was the last one.
+    void Drop();
+
+    /// Copy up to `size` bytes, starting at `position` in the file, into
+    /// `into`.  Return how many there were.
+    int ReadAt(char *into, unsigned size, unsigned position) const;
+
+    /// Return the size of the file.
+    unsigned Length() const;
+
+private:
+
+    ~ExecutableImage();
+
+    char *contents;
+    unsigned length;
+    unsigned holds;
+};
+
 /// Assumes that the object code file is in NOFF format.
 class Executable {
 public:
+    /// Read the program from `new_file`, which is then owned by the
+    /// executable, and deleted along with it.
     Executable(OpenFile *new_file);
 
+    /// Read the program from `image` instead of a file, holding it for as
+    /// long as the executable exists.
+    Executable(ExecutableImage *image);
+
+    ~Executable();
+
     /// Check if the executable is valid and fix endianness if necessary.
     ///
     /// Check if the executable conforms to the NOFF file format by checking
@@ -62,8 +103,23 @@ public:
     int ReadCodeBlock(char *dest, uint32_t size, uint32_t offset);
     int ReadDataBlock(char *dest, uint32_t size, uint32_t offset);
 
+    /// Read the part of the program image that falls in the `size` bytes
+    /// of memory starting at address `addr`, into `dest` (which stands for
+    /// `addr`).
+    ///
+    /// Only the code and initialized data segments are read; bytes of
+    /// `dest` outside of them are left untouched.  When both segments are
+    /// needed and follow each other both in memory and in the file, as
+    /// `coff2noff` lays them out, they are read at once.
+    void ReadImage(char *dest, uint32_t addr, uint32_t size);
+
 private:
+
+    /// Read from the file or, if there is one, from the image.
+    int ReadAt(char *into, unsigned size, unsigned position);
+
     OpenFile *file;
+    ExecutableImage *image;
     noffHeader header;
 };
 
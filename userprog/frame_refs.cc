@@ -0,0 +1,48 @@
+/// Routines to count the address spaces sharing each frame.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#ifdef COPY_ON_WRITE
+
+
+#include "frame_refs.hh"
+#include "threads/system.hh"
+
+
+FrameRefs::FrameRefs()
+{
+    extra = new unsigned [numPhysPages];
+    for (unsigned i = 0; i < numPhysPages; i++) {
+        extra[i] = 0;
+    }
+}
+
+FrameRefs::~FrameRefs()
+{
+    delete [] extra;
+}
+
+void
+FrameRefs::Share(unsigned frame)
+{
+    ASSERT(frame < numPhysPages);
+    extra[frame]++;
+}
+
+bool
+FrameRefs::Drop(unsigned frame)
+{
+    ASSERT(frame < numPhysPages);
+
+    if (extra[frame] == 0) {
+        return true;
+    }
+    extra[frame]--;
+    return false;
+}
+
+
+#endif
@@ -0,0 +1,55 @@
+/// Reference counts of the frames of physical memory shared by forked
+/// address spaces.
+///
+/// `Fork` does not copy the memory of the parent: the child maps the same
+/// frames, and both map them read-only.  The first write to such a page
+/// raises a read-only exception, and only then is the page copied into a
+/// frame of the writer's own (see `AddressSpace::CopyOnWrite`).  This table
+/// counts, for every frame, how many address spaces map it, so that a frame
+/// is freed when its last mapping goes away, and the last one left mapping
+/// it can write to it without copying.
+///
+/// Frames that are not shared are not counted: a count of 0 stands for a
+/// single mapping, so that frames need no setting up when allocated.
+///
+/// Only available when address spaces are loaded eagerly (that is, without
+/// *DEMAND_LOADING* or *SWAP*), since the swapping code assumes that each
+/// frame belongs to a single address space.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_FRAMEREFS__HH
+#define NACHOS_USERPROG_FRAMEREFS__HH
+
+
+#if defined(COPY_ON_WRITE) && (defined(DEMAND_LOADING) || defined(SWAP))
+#error "COPY_ON_WRITE cannot be used with DEMAND_LOADING or SWAP."
+#endif
+
+
+class FrameRefs {
+public:
+
+    /// Create the table, with every frame mapped at most once.
+    FrameRefs();
+
+    ~FrameRefs();
+
+    /// Record that one more address space maps `frame`.
+    void Share(unsigned frame);
+
+    /// Record that an address space no longer maps `frame`.
+    ///
+    /// Return true if it was the last one, so that the frame can be freed.
+    bool Drop(unsigned frame);
+
+private:
+
+    /// Address spaces mapping each frame, besides the first.
+    unsigned *extra;
+};
+
+
+#endif
@@ -0,0 +1,111 @@
+/// Routines to cache executable files.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#ifdef EXEC_CACHE
+
+
+#include "image_cache.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+ImageCache::ImageCache()
+{
+    for (unsigned i = 0; i < SIZE; i++) {
+        entries[i].name = nullptr;
+        entries[i].image = nullptr;
+        entries[i].lastUse = 0;
+    }
+    clock = 0;
+}
+
+ImageCache::~ImageCache()
+{
+    for (unsigned i = 0; i < SIZE; i++) {
+        Clear(&entries[i]);
+    }
+}
+
+Executable *
+ImageCache::Open(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    clock++;
+    Entry *e = Find(name);
+    if (e != nullptr) {
+        e->lastUse = clock;
+        stats->cachedExecs++;
+        DEBUG('a', "Starting %s from the executable cache\n", name);
+        return new Executable(e->image);
+    }
+
+    OpenFile *file = fileSystem->Open(name);
+    if (file == nullptr) {
+        return nullptr;
+    }
+    ExecutableImage *image = new ExecutableImage(file);
+    delete file;
+    stats->readExecs++;
+
+    // Reading may have let another thread cache the same file meanwhile.
+    Forget(name);
+    e = &entries[0];
+    for (unsigned i = 1; i < SIZE && e->name != nullptr; i++) {
+        if (entries[i].name == nullptr || entries[i].lastUse < e->lastUse) {
+            e = &entries[i];
+        }
+    }
+    Clear(e);
+    e->name = new char [strlen(name) + 1];
+    strcpy(e->name, name);
+    e->image = image;  // The hold taken when reading it is the cache's.
+    e->lastUse = clock;
+    return new Executable(image);
+}
+
+void
+ImageCache::Forget(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    Entry *e = Find(name);
+    if (e != nullptr) {
+        DEBUG('a', "Dropping %s from the executable cache\n", name);
+        Clear(e);
+    }
+}
+
+ImageCache::Entry *
+ImageCache::Find(const char *name)
+{
+    for (unsigned i = 0; i < SIZE; i++) {
+        if (entries[i].name != nullptr
+              && strcmp(entries[i].name, name) == 0) {
+            return &entries[i];
+        }
+    }
+    return nullptr;
+}
+
+void
+ImageCache::Clear(Entry *e)
+{
+    ASSERT(e != nullptr);
+
+    if (e->name == nullptr) {
+        return;
+    }
+    delete [] e->name;
+    e->name = nullptr;
+    e->image->Drop();
+    e->image = nullptr;
+}
+
+
+#endif
@@ -0,0 +1,71 @@
+/// System-wide cache of the executable files started by `Exec`.
+///
+/// Shells and scripts start the same few programs over and over.  Instead
+/// of opening the file, reading its header and then reading its segments
+/// page by page every time, the cache keeps the whole file in memory (see
+/// `ExecutableImage`), so that starting a program it holds takes no file
+/// operation at all.
+///
+/// Files are told apart by their name.  The image of a file is dropped when
+/// a file of that name is created or removed, or when a user program writes
+/// to it (its name is found in `OpenNames`).  Address spaces already started
+/// from an image that is dropped keep using it until they go away.
+///
+/// The cache holds a few images, and makes room for new ones by dropping
+/// the least recently used.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_IMAGECACHE__HH
+#define NACHOS_USERPROG_IMAGECACHE__HH
+
+
+#include "executable.hh"
+
+
+class ImageCache {
+public:
+
+    /// Create an empty cache.
+    ImageCache();
+
+    ~ImageCache();
+
+    /// Return an executable for the file `name`, read from the cache if it
+    /// is there, or else from the file, which is then cached.
+    ///
+    /// Return null if the file cannot be opened.  The caller owns the
+    /// result.
+    Executable *Open(const char *name);
+
+    /// Drop the image of the file `name`, if cached, for instance because
+    /// it was replaced or removed.
+    void Forget(const char *name);
+
+private:
+
+    /// Images kept at once.
+    static const unsigned SIZE = 8;
+
+    struct Entry {
+        char *name;              ///< File name, or null if unused.
+        ExecutableImage *image;
+        unsigned long lastUse;   ///< Value of `clock` when last opened.
+    };
+
+    /// Return the entry for `name`, or null if there is none.
+    Entry *Find(const char *name);
+
+    /// Drop the image of `e` and leave it unused.
+    void Clear(Entry *e);
+
+    Entry entries[SIZE];
+
+    /// Counts calls to `Open`, to find the least recently used entry.
+    unsigned long clock;
+};
+
+
+#endif
@@ -0,0 +1,75 @@
+/// Routines to record the names of the files opened by user programs.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#if defined(SHARED_TEXT) || defined(EXEC_CACHE)
+
+
+#include "open_names.hh"
+#include "lib/utility.hh"
+
+#include <string.h>
+
+
+OpenNames::OpenNames()
+{
+    first = nullptr;
+}
+
+OpenNames::~OpenNames()
+{
+    while (first != nullptr) {
+        OpenName *next = first->next;
+        delete [] first->name;
+        delete first;
+        first = next;
+    }
+}
+
+void
+OpenNames::Opened(const OpenFile *file, const char *name)
+{
+    ASSERT(file != nullptr);
+    ASSERT(name != nullptr);
+
+    // A file that was never closed may have left its address to this one.
+    Closed(file);
+
+    OpenName *o = new OpenName;
+    o->file = file;
+    o->name = new char [strlen(name) + 1];
+    strcpy(o->name, name);
+    o->next = first;
+    first = o;
+}
+
+void
+OpenNames::Closed(const OpenFile *file)
+{
+    for (OpenName **o = &first; *o != nullptr; o = &(*o)->next) {
+        if ((*o)->file == file) {
+            OpenName *gone = *o;
+            *o = gone->next;
+            delete [] gone->name;
+            delete gone;
+            return;
+        }
+    }
+}
+
+const char *
+OpenNames::Find(const OpenFile *file) const
+{
+    for (const OpenName *o = first; o != nullptr; o = o->next) {
+        if (o->file == file) {
+            return o->name;
+        }
+    }
+    return nullptr;
+}
+
+
+#endif
@@ -0,0 +1,50 @@
+/// Names under which user programs opened their files.
+///
+/// Open files do not know their name, but the caches of executables (see
+/// `TextCache` and `ImageCache`) are keyed by file name, and must drop what
+/// they hold of a file when a user program writes to it.  So the kernel
+/// records here which file each user program opens under which name.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_OPENNAMES__HH
+#define NACHOS_USERPROG_OPENNAMES__HH
+
+
+#include "filesys/open_file.hh"
+
+
+class OpenNames {
+public:
+
+    /// Create an empty record.
+    OpenNames();
+
+    ~OpenNames();
+
+    /// Record that a user program opened `file`, with the name `name`.
+    void Opened(const OpenFile *file, const char *name);
+
+    /// Record that `file` was closed.
+    void Closed(const OpenFile *file);
+
+    /// Return the name `file` was opened with, or null if it is not known.
+    const char *Find(const OpenFile *file) const;
+
+private:
+
+    /// A file opened by a user program.
+    struct OpenName {
+        const OpenFile *file;
+        char *name;
+        OpenName *next;
+    };
+
+    /// Files opened by user programs and not closed yet.
+    OpenName *first;
+};
+
+
+#endif
@@ -33,13 +33,9 @@ StartProcess(const char *filename)
 
     SpaceId spaceId = (SpaceId)runningProcesses->Add(currentThread);
 
-    AddressSpace *space = new AddressSpace(executable, spaceId);
+    AddressSpace *space = new AddressSpace(executable, spaceId, filename);
     currentThread->space = space;
 
-    #ifndef DEMAND_LOADING
-    delete executable;
-    #endif
-
     space->InitRegisters();  // Set the initial register values.
     space->RestoreState();   // Load page table register.
 
@@ -66,12 +66,15 @@ SpaceId Exec(char *name,char **argv ,int joinable);
 int Join(SpaceId id);
 
 
-/// User-level thread operations: `Fork` and `Yield`.  To allow multiple
-/// threads to run within a user program.
+/// Process and thread operations: `Fork` and `Yield`.
 
-/// Fork a thread to run a procedure (`func`) in the *same* address space as
-/// the current thread.
-int Fork(void (*func)(void));
+/// Start a new process, running a copy of the address space of the current
+/// one, from this same call.
+///
+/// Return the address space identifier of the new process to the caller,
+/// and 0 to the new process.  If `joinable` is not zero, the caller must
+/// `Join` the new process.  Open files are not inherited.
+SpaceId Fork(int joinable);
 
 /// Yield the CPU to another runnable thread, whether in this address space
 /// or not.
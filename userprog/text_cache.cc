@@ -0,0 +1,147 @@
+/// Routines to share the code pages of executables.
+///
+/// Pages are looked up by walking every frame, which is cheap next to
+/// loading a page, and only happens when a program is started.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#ifdef SHARED_TEXT
+
+
+#include "text_cache.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+TextCache::TextCache()
+{
+    entries = new Entry [numPhysPages];
+    for (unsigned i = 0; i < numPhysPages; i++) {
+        entries[i].name = nullptr;
+        entries[i].refs = 0;
+        entries[i].held = false;
+    }
+}
+
+TextCache::~TextCache()
+{
+    for (unsigned i = 0; i < numPhysPages; i++) {
+        delete [] entries[i].name;
+    }
+    delete [] entries;
+}
+
+int
+TextCache::Acquire(const char *name, const Executable *exe, unsigned vpn)
+{
+    ASSERT(name != nullptr);
+    ASSERT(exe != nullptr);
+
+    for (unsigned i = 0; i < numPhysPages; i++) {
+        Entry *e = &entries[i];
+        if (e->name != nullptr && e->vpn == vpn
+              && e->codeAddr == exe->GetCodeAddr()
+              && e->codeSize == exe->GetCodeSize()
+              && strcmp(e->name, name) == 0) {
+            e->refs++;
+            stats->sharedTextPages++;
+            DEBUG('a', "Sharing page %u of %s, in frame %u\n", vpn, name, i);
+            return i;
+        }
+    }
+    return -1;
+}
+
+void
+TextCache::Insert(const char *name, const Executable *exe, unsigned vpn,
+                  unsigned frame)
+{
+    ASSERT(name != nullptr);
+    ASSERT(exe != nullptr);
+    ASSERT(frame < numPhysPages);
+    ASSERT(!entries[frame].held);
+
+    Entry *e = &entries[frame];
+    e->name = new char [strlen(name) + 1];
+    strcpy(e->name, name);
+    e->codeAddr = exe->GetCodeAddr();
+    e->codeSize = exe->GetCodeSize();
+    e->vpn      = vpn;
+    e->refs     = 1;
+    e->held     = true;
+}
+
+void
+TextCache::Share(unsigned frame)
+{
+    ASSERT(Holds(frame));
+    ASSERT(entries[frame].refs > 0);
+
+    entries[frame].refs++;
+}
+
+void
+TextCache::Release(unsigned frame)
+{
+    ASSERT(Holds(frame));
+    ASSERT(entries[frame].refs > 0);
+
+    Entry *e = &entries[frame];
+    e->refs--;
+    if (e->refs == 0 && e->name == nullptr) {
+        Free(frame);
+    }
+}
+
+bool
+TextCache::Holds(unsigned frame) const
+{
+    ASSERT(frame < numPhysPages);
+    return entries[frame].held;
+}
+
+int
+TextCache::Reclaim()
+{
+    for (unsigned i = 0; i < numPhysPages; i++) {
+        if (entries[i].held && entries[i].refs == 0) {
+            DEBUG('a', "Reclaiming cached code page in frame %u\n", i);
+            delete [] entries[i].name;
+            entries[i].name = nullptr;
+            entries[i].held = false;
+            return i;  // Still marked as used in `pagesInUse`.
+        }
+    }
+    return -1;
+}
+
+void
+TextCache::Forget(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    for (unsigned i = 0; i < numPhysPages; i++) {
+        Entry *e = &entries[i];
+        if (e->name != nullptr && strcmp(e->name, name) == 0) {
+            delete [] e->name;
+            e->name = nullptr;
+            if (e->refs == 0) {
+                Free(i);
+            }
+        }
+    }
+}
+
+void
+TextCache::Free(unsigned frame)
+{
+    entries[frame].held = false;
+    pagesInUse->Clear(frame);
+}
+
+
+#endif
@@ -0,0 +1,97 @@
+/// System-wide cache of the code pages of executables, shared read-only by
+/// every process running the same program.
+///
+/// Pages that hold nothing but code never change, so every address space
+/// running a program maps the same frame for each of them, instead of a
+/// private copy.  The cache keeps, for every frame of physical memory, which
+/// page of which executable it holds and how many address spaces map it.
+/// When the last one goes away the frame stays cached, so that the next
+/// process running the program (such as the shell starting `cat` again)
+/// finds its code already loaded; such frames are given back when memory
+/// runs out (see `Reclaim`).
+///
+/// Executables are told apart by their file name, and by the place and size
+/// of their code segment.  Pages of a file are forgotten when a file of that
+/// name is created or removed, or when a user program writes to it (its
+/// name is found in `OpenNames`).
+///
+/// Only available when address spaces are loaded eagerly (that is, without
+/// *DEMAND_LOADING* or *SWAP*), since the swapping code assumes that each
+/// frame belongs to a single address space.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_TEXTCACHE__HH
+#define NACHOS_USERPROG_TEXTCACHE__HH
+
+
+#include "executable.hh"
+
+
+#if defined(SHARED_TEXT) && (defined(DEMAND_LOADING) || defined(SWAP))
+#error "SHARED_TEXT cannot be used with DEMAND_LOADING or SWAP."
+#endif
+
+
+class TextCache {
+public:
+
+    /// Create an empty cache, for every frame of physical memory.
+    TextCache();
+
+    ~TextCache();
+
+    /// Look for the frame holding code page `vpn` of the executable `exe`,
+    /// opened from file `name`.
+    ///
+    /// If there is one, take a reference to it and return it; otherwise
+    /// return -1.
+    int Acquire(const char *name, const Executable *exe, unsigned vpn);
+
+    /// Record that `frame`, which has just been loaded, holds code page
+    /// `vpn` of `exe`, opened from `name`, and is mapped once.
+    void Insert(const char *name, const Executable *exe, unsigned vpn,
+                unsigned frame);
+
+    /// Take one more reference to `frame`, which must be held by the cache
+    /// and already mapped, for an address space copied from another one.
+    void Share(unsigned frame);
+
+    /// Drop a reference to `frame`, which must be held by the cache.
+    void Release(unsigned frame);
+
+    /// Does `frame` hold a page of the cache?
+    bool Holds(unsigned frame) const;
+
+    /// Take a frame that holds a cached page no address space maps, so
+    /// that it can be used for something else.  Return -1 if there is none.
+    int Reclaim();
+
+    /// Stop sharing the pages of the file `name`, for instance because it
+    /// was replaced.  Frames mapped by no address space are freed; the
+    /// others are freed when their last reference is dropped.
+    void Forget(const char *name);
+
+private:
+
+    struct Entry {
+        char *name;         ///< Executable file, or null if the frame
+                            ///< is not in the cache or was forgotten.
+        unsigned codeAddr;  ///< Code segment of the executable.
+        unsigned codeSize;
+        unsigned vpn;       ///< Page held by the frame.
+        unsigned refs;      ///< Address spaces mapping the frame.
+        bool held;          ///< Whether the frame belongs to the cache.
+    };
+
+    /// Give `frame` back to the free frames.
+    void Free(unsigned frame);
+
+    /// One entry for each frame of physical memory.
+    Entry *entries;
+};
+
+
+#endif
@@ -8,7 +8,10 @@
 
 
 /// Copy a byte array from virtual machine to host.
-void ReadBufferFromUser(int userAddress, char *outBuffer,
+///
+/// Like the other copies, return false if some page could not be
+/// accessed.
+bool ReadBufferFromUser(int userAddress, char *outBuffer,
                         unsigned byteCount);
 
 /// Copy a C string from virtual machine to host.
@@ -16,11 +19,11 @@ bool ReadStringFromUser(int userAddress, char *outString,
                         unsigned maxByteCount);
 
 /// Copy a byte array from host to virtual machine.
-void WriteBufferToUser(const char *buffer, int userAddress,
+bool WriteBufferToUser(const char *buffer, int userAddress,
                        unsigned byteCount);
 
 /// Copy a C string from host to virtual machine.
-void WriteStringToUser(const char *string, int userAddress);
+bool WriteStringToUser(const char *string, int userAddress);
 
 
 #endif